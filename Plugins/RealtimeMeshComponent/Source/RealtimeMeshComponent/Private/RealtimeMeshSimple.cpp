@@ -9,6 +9,7 @@
 #include "RenderProxy/RealtimeMeshSectionGroupProxy.h"
 #include "RenderProxy/RealtimeMeshVertexFactory.h"
 #include "Async/Async.h"
+#include "Async/ParallelFor.h"
 #include "Core/RealtimeMeshFuture.h"
 #include "Data/RealtimeMeshUpdateBuilder.h"
 #include "Mesh/RealtimeMeshAlgo.h"
@@ -27,7 +28,11 @@ namespace RealtimeMesh
 	namespace Simple::Private
 	{
 		static thread_local bool bShouldDeferPolyGroupUpdates = false;		
-	}	
+
+		// Cooks gathered from every mesh during the end of frame updates, only touched on the game thread
+		static TArray<TUniquePtr<FRealtimeMeshSimple::FCollisionCookRequest>> PendingAsyncCooks;
+		static TArray<TUniquePtr<FRealtimeMeshSimple::FCollisionCookRequest>> PendingGameThreadCooks;
+	}
 	
 	FRealtimeMeshSectionSimple::FRealtimeMeshSectionSimple(const FRealtimeMeshSharedResourcesRef& InSharedResources, const FRealtimeMeshSectionKey& InKey)
 		: FRealtimeMeshSection(InSharedResources, InKey)
@@ -708,6 +713,7 @@ namespace RealtimeMesh
 	void FRealtimeMeshSimple::MarkCollisionDirtyNoCallback() const
 	{
 		FRealtimeMeshScopeGuardWrite ScopeGuard(SharedResources);
+		CollisionDirtyCounter.Increment();
 		MarkForEndOfFrameUpdate();
 
 		if (!PendingCollisionPromise.IsValid())
@@ -719,6 +725,7 @@ namespace RealtimeMesh
 	TFuture<ERealtimeMeshCollisionUpdateResult> FRealtimeMeshSimple::MarkCollisionDirty() const
 	{
 		FRealtimeMeshScopeGuardWrite ScopeGuard(SharedResources);
+		CollisionDirtyCounter.Increment();
 		MarkForEndOfFrameUpdate();
 
 		if (!PendingCollisionPromise.IsValid())
@@ -742,57 +749,97 @@ namespace RealtimeMesh
 
 	void FRealtimeMeshSimple::ProcessEndOfFrameUpdates()
 	{
+		check(IsInGameThread());
+		
 		TSharedPtr<TPromise<ERealtimeMeshCollisionUpdateResult>> CollisionPromise;
+		int32 DirtyVersion;
 		{
 			FRealtimeMeshScopeGuardWrite ScopeGuard(SharedResources);
 			CollisionPromise = MoveTemp(PendingCollisionPromise);
 			PendingCollisionPromise.Reset();
+			DirtyVersion = CollisionDirtyCounter.GetValue();
 		}
 		
 		if (CollisionPromise.IsValid())
 		{
-			auto Promise = MoveTemp(*CollisionPromise);
+			// Queued instead of cooked right away so every mesh dirtied this frame is built together in DispatchCollisionCooks
+			auto Request = MakeUnique<FCollisionCookRequest>();
+			Request->Mesh = StaticCastWeakPtr<FRealtimeMeshSimple>(this->AsWeak());
+			Request->CollisionData.Configuration = CollisionConfig;
+			Request->CollisionData.SimpleGeometry = SimpleGeometry;
+			Request->Promise = MoveTemp(*CollisionPromise);
+			Request->UpdateKey = GetNextCollisionUpdateVersion();
+			Request->DirtyVersion = DirtyVersion;
+
+			if (CollisionConfig.bUseAsyncCook)
+			{
+				Simple::Private::PendingAsyncCooks.Add(MoveTemp(Request));
+			}
+			else
+			{
+				Simple::Private::PendingGameThreadCooks.Add(MoveTemp(Request));
+			}
+		}
+		FRealtimeMesh::ProcessEndOfFrameUpdates();
+	}
 
-			const int32 UpdateKey = GetNextCollisionUpdateVersion();
-			
-			const bool bAsyncCook = CollisionConfig.bUseAsyncCook;
-			const ERealtimeMeshThreadType AllowedGenerationThread = bAsyncCook ? ERealtimeMeshThreadType::AsyncThread : ERealtimeMeshThreadType::GameThread;
+	void FRealtimeMeshSimple::CookCollision(FCollisionCookRequest& Request)
+	{
+		const auto ThisShared = Request.Mesh.Pin();
 
-			auto CollisionData = MakeShared<FRealtimeMeshCollisionInfo>();
-			CollisionData->Configuration = CollisionConfig;
-			CollisionData->SimpleGeometry = SimpleGeometry;
-			
-			auto ThisWeak = StaticCastWeakPtr<FRealtimeMeshSimple>(this->AsWeak());
+		// Dirtied again since this was queued, the cook queued for that change replaces this one
+		if (!ThisShared || ThisShared->CollisionDirtyCounter.GetValue() != Request.DirtyVersion)
+		{
+			DoOnGameThread([ResultPromise = MoveTemp(Request.Promise)]() mutable
+			{
+				ResultPromise.EmplaceValue(ERealtimeMeshCollisionUpdateResult::Ignored);
+			});
+			return;
+		}
 
-			DoOnAllowedThread(AllowedGenerationThread, [ThisWeak, CollisionData, ResultPromise = MoveTemp(Promise), UpdateKey]() mutable
-			{				
-				if (const auto ThisShared = ThisWeak.Pin())
-				{
-					FRealtimeMeshAccessContext AccessContext(ThisShared.ToSharedRef());
-					FRealtimeMeshComplexGeometry NewComplexGeometry;
-					
-					if (ThisShared->GenerateComplexCollision(AccessContext, NewComplexGeometry))
-					{
-						CollisionData->ComplexGeometry = MoveTemp(NewComplexGeometry);
-					}
+		{
+			FRealtimeMeshAccessContext AccessContext(ThisShared.ToSharedRef());
+			FRealtimeMeshComplexGeometry NewComplexGeometry;
 
-					auto CollisionUpdateFuture = ThisShared->UpdateCollision(MoveTemp(*CollisionData), UpdateKey);
+			if (ThisShared->GenerateComplexCollision(AccessContext, NewComplexGeometry))
+			{
+				Request.CollisionData.ComplexGeometry = MoveTemp(NewComplexGeometry);
+			}
+		}
 
-					ContinueOnGameThread(MoveTemp(CollisionUpdateFuture), [ResultPromise = MoveTemp(ResultPromise)](TFuture<ERealtimeMeshCollisionUpdateResult>&& Result) mutable
-					{
-						ResultPromise.EmplaceValue(Result.Get());
-					});
-				}
-				else
+		auto CollisionUpdateFuture = ThisShared->UpdateCollision(MoveTemp(Request.CollisionData), Request.UpdateKey);
+
+		ContinueOnGameThread(MoveTemp(CollisionUpdateFuture), [ResultPromise = MoveTemp(Request.Promise)](TFuture<ERealtimeMeshCollisionUpdateResult>&& Result) mutable
+		{
+			ResultPromise.EmplaceValue(Result.Get());
+		});
+	}
+
+	void FRealtimeMeshSimple::DispatchCollisionCooks()
+	{
+		check(IsInGameThread());
+
+		if (Simple::Private::PendingGameThreadCooks.Num() > 0)
+		{
+			auto Requests = MoveTemp(Simple::Private::PendingGameThreadCooks);
+
+			// Still blocks the game thread like before, but the meshes are generated and cooked side by side
+			ParallelFor(Requests.Num(), [&Requests](int32 Index)
+			{
+				CookCollision(*Requests[Index]);
+			});
+		}
+
+		if (Simple::Private::PendingAsyncCooks.Num() > 0)
+		{
+			DoOnAsyncThread([Requests = MoveTemp(Simple::Private::PendingAsyncCooks)]() mutable
+			{
+				ParallelFor(Requests.Num(), [&Requests](int32 Index)
 				{
-					DoOnGameThread([ResultPromise = MoveTemp(ResultPromise)]() mutable
-					{
-						ResultPromise.EmplaceValue(ERealtimeMeshCollisionUpdateResult::Ignored);
-					});
-				}
+					CookCollision(*Requests[Index]);
+				});
 			});
 		}
-		FRealtimeMesh::ProcessEndOfFrameUpdates();
 	}
 }
 
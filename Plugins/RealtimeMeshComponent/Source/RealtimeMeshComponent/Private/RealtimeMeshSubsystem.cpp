@@ -2,6 +2,7 @@
 
 #include "RealtimeMeshSubsystem.h"
 #include "RealtimeMeshActor.h"
+#include "RealtimeMeshSimple.h"
 #include "RealtimeMeshSceneViewExtension.h"
 #include "SceneViewExtension.h"
 #include "Engine/Engine.h"
@@ -113,6 +114,9 @@ void RealtimeMesh::FRealtimeMeshEndOfFrameUpdateManager::OnPreSendAllEndOfFrameU
 			Mesh->ProcessEndOfFrameUpdates();
 		}
 	}
+
+	// Collision is only queued above so all meshes of the frame cook as one parallel batch
+	FRealtimeMeshSimple::DispatchCollisionCooks();
 }
 
 RealtimeMesh::FRealtimeMeshEndOfFrameUpdateManager::~FRealtimeMeshEndOfFrameUpdateManager()
@@ -283,6 +283,9 @@ namespace RealtimeMesh
 		// Pending collision update promise. Used to alert when the collision finishes updating
 		mutable TSharedPtr<TPromise<ERealtimeMeshCollisionUpdateResult>> PendingCollisionPromise;
 
+		// Bumped every time the collision is dirtied, lets a queued cook notice it has been superseded
+		mutable FThreadSafeCounter CollisionDirtyCounter;
+
 		// Distance field representation for this mesh
 		FRealtimeMeshDistanceField DistanceField;
 
@@ -341,7 +344,21 @@ namespace RealtimeMesh
 		virtual void FinalizeUpdate(FRealtimeMeshUpdateContext& UpdateContext) override;
 
 		virtual bool Serialize(FArchive& Ar, URealtimeMesh* Owner) override;
+
+		struct FCollisionCookRequest
+		{
+			TWeakPtr<FRealtimeMeshSimple> Mesh;
+			FRealtimeMeshCollisionInfo CollisionData;
+			TPromise<ERealtimeMeshCollisionUpdateResult> Promise;
+			int32 UpdateKey;
+			int32 DirtyVersion;
+		};
+
+		// Generates and cooks the collision of every mesh queued this frame in parallel. Called once the end of frame updates ran.
+		static void DispatchCollisionCooks();
 	protected:
+		static void CookCollision(FCollisionCookRequest& Request);
+
 		void MarkCollisionDirtyNoCallback() const;
 		TFuture<ERealtimeMeshCollisionUpdateResult> MarkCollisionDirty() const;
 
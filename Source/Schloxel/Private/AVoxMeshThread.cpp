@@ -1,11 +1,60 @@
 #include "AVoxMeshThread.h"
 #include "Enums.h"
 #include "VoxModel.h"
+#include "MeshApplySubsystem.h"
+#include "MeshCache.h"
+#include "MeshScratch.h"
+#include "VoxMemory.h"
+#include "Async/Async.h"
+#include "Hash/CityHash.h"
+
+AVoxMeshThread::AVoxMeshThread(AVoxModel* VoxModel, uint32 _Revision, int32 _ModelIndex)
+{
+	WeakModel = VoxModel;
+	ModelIndex = _ModelIndex;
+	Revision = _Revision;
+	VoxelSize = VoxModel->VoxelSize;
+
+	if (ModelIndex == INDEX_NONE)
+	{
+		// A snapshot, edits made while the thread runs clone the bricks they touch
+		Volume = VoxModel->Blocks;
+		SharedModel = VoxModel->SharedModel;
+		bFirstGeneration = !VoxModel->bEdited;
+	}
+	else
+	{
+		// Converted here on the game thread, the scene may be flattened while the thread runs
+		const FVoxModelGrid& Model = VoxModel->InstancedScene.Models[ModelIndex];
+
+		TArray<EBlock> ModelBlocks;
+		ModelBlocks.SetNumUninitialized(Model.ColorIndices.Num());
+		for (int32 i = 0; i < Model.ColorIndices.Num(); i++)
+		{
+			ModelBlocks[i] = Model.ColorIndices[i] != 0 ? EBlock::Stone : EBlock::Air;
+		}
+		Volume = FVoxBlockVolume(Model.Dimensions, ModelBlocks);
+	}
+
+	GridDimensions = Volume.GetDimensions();
+
+	// Debug drawing stays on the game thread, instanced models have no place in the flattened grid
+	if (ModelIndex == INDEX_NONE)
+	{
+		VisualizeChunks(VoxModel);
+	}
+}
 
-AVoxMeshThread::AVoxMeshThread(AVoxModel* _VoxModel)
+void AVoxMeshThread::Launch(AVoxModel* VoxModel, uint32 _Revision, int32 _ModelIndex)
 {
-	VoxModel = _VoxModel;
-	FRunnableThread::Create(this, TEXT("VoxMeshThread"));
+	Async(EAsyncExecution::ThreadPool, [Job = MakeUnique<AVoxMeshThread>(VoxModel, _Revision, _ModelIndex)]()
+	{
+		if (Job->Init())
+		{
+			Job->Run();
+			Job->Exit();
+		}
+	});
 }
 
 bool AVoxMeshThread::Init()
@@ -16,12 +65,31 @@ bool AVoxMeshThread::Init()
 
 uint32 AVoxMeshThread::Run()
 {
-    // Visualize chunks first
-    VisualizeChunks();
-    
-    // Then generate the mesh
+    LLM_SCOPE_BYTAG(Voxel_MeshData);
+
+    // The same prop placed or loaded again meshes the same, the flattened grid is centred so it keys apart.
+    // Edited grids are unlikely to come back and are neither hashed nor kept.
+    const bool bUseCache = bFirstGeneration && VoxMeshCache::IsEnabled();
+    const uint64 CacheKey = bUseCache
+        ? CityHash128to64(Uint128_64(Volume.GetContentHash(), GetTypeHash(VoxelSize) | static_cast<uint64>(ModelIndex == INDEX_NONE) << 32))
+        : 0;
+
+    if (bUseCache)
+    {
+        Result = VoxMeshCache::Models().Find(CacheKey);
+        if (Result)
+            return 0;
+    }
+
     BuildGreedyMeshParallel();
-    VoxModel->MeshDataQueue.Enqueue(VoxMeshData);
+
+    // Only the geometry, which model and actors it belongs to stays with the job. Shared with the cache.
+    Result = MakeShared<const FVoxMeshData>(MoveTemp(VoxMeshData));
+
+    if (bUseCache)
+    {
+        VoxMeshCache::Models().Add(CacheKey, Result);
+    }
     
     return 0;
 }
@@ -30,7 +98,7 @@ uint32 AVoxMeshThread::Run()
 void AVoxMeshThread::BuildGreedyMeshParallel()
 {
     const int32 NumThreads = FPlatformMisc::NumberOfCores();
-    const int32 ChunkSize = FMath::Max(1, VoxModel->ModelDimensions.Z / NumThreads);
+    const int32 ChunkSize = FMath::Max(1, GridDimensions.Z / NumThreads);
     
     struct FChunkResult
     {
@@ -43,10 +111,13 @@ void AVoxMeshThread::BuildGreedyMeshParallel()
 
     ParallelFor(NumThreads, [&](int32 ThreadIndex)
     {
+        // Workers don't inherit the scope of Run
+        LLM_SCOPE_BYTAG(Voxel_MeshData);
+
         const int32 StartZ = ThreadIndex * ChunkSize;
         const int32 EndZ = (ThreadIndex == NumThreads-1) ? 
-            VoxModel->ModelDimensions.Z : 
-            FMath::Min(StartZ + ChunkSize, VoxModel->ModelDimensions.Z);
+            GridDimensions.Z : 
+            FMath::Min(StartZ + ChunkSize, GridDimensions.Z);
 
         FVoxMeshData LocalChunkData;
         BuildGreedyMeshChunk(StartZ, EndZ, LocalChunkData);
@@ -83,38 +154,34 @@ void AVoxMeshThread::BuildGreedyMeshParallel()
 
 void AVoxMeshThread::BuildGreedyMeshChunk(int32 StartZ, int32 EndZ, FVoxMeshData& ChunkData)
 {
-    struct FaceMask {
-        uint8 Active : 1;
-        uint8 BlockType : 7;
-    };
-
     static const FIntVector Normals[] = {
         FIntVector(1, 0, 0), FIntVector(-1, 0, 0),
         FIntVector(0, 1, 0), FIntVector(0, -1, 0),
         FIntVector(0, 0, 1), FIntVector(0, 0, -1)
     };
 
-    const FIntVector& Dims = VoxModel->ModelDimensions;
-    const float Scale = VoxModel->VoxelSize;
-    const FVector CenterOffset = FVector(
+    const FIntVector& Dims = GridDimensions;
+    const float Scale = VoxelSize;
+    const FVector CenterOffset = ModelIndex == INDEX_NONE ? FVector(
         -Dims.X * Scale * 0.5f,
         -Dims.Y * Scale * 0.5f,
         0.0f
-    );
+    ) : FVector::ZeroVector;
 
-    const int32 EstimatedVertices = (EndZ - StartZ) * Dims.X * Dims.Y;
-    TArray<FVector> Vertices;
-    TArray<int32> Triangles;
-    TArray<FVector> MeshNormals;
-    TArray<FVector2D> UVs;
-    
-    Vertices.Reserve(EstimatedVertices * 4);
-    Triangles.Reserve(EstimatedVertices * 6);
-    MeshNormals.Reserve(EstimatedVertices * 4);
-    UVs.Reserve(EstimatedVertices * 4);
+    // Staging grows to the biggest slab this scratch has seen instead of reserving for every voxel being a face
+    FMeshScratchScope Scratch;
+
+    TArray<FVector>& Vertices = Scratch->Staging.Vertices;
+    TArray<int32>& Triangles = Scratch->Staging.Triangles;
+    TArray<FVector>& MeshNormals = Scratch->Staging.Normals;
+    TArray<FVector2D>& UVs = Scratch->Staging.UV0;
+
+    Vertices.Reset();
+    Triangles.Reset();
+    MeshNormals.Reset();
+    UVs.Reset();
 
-    const int32 DimXY = Dims.X * Dims.Y;
-    TArray<FaceMask> Mask;
+    TArray<FVoxFaceMask>& Mask = Scratch->VoxMask;
 
     for (int32 Dir = 0; Dir < 6; Dir++)
     {
@@ -123,7 +190,7 @@ void AVoxMeshThread::BuildGreedyMeshChunk(int32 StartZ, int32 EndZ, FVoxMeshData
         const int32 Dim2 = Dims[(Dir / 2 + 2) % 3];
         const int32 MaskSize = Dim1 * Dim2;
 
-        Mask.Empty(MaskSize);
+        Mask.Reset(MaskSize);
         Mask.AddZeroed(MaskSize);
 
         const int32 StartD = (Dir / 2 == 2) ? StartZ : 0;
@@ -146,20 +213,8 @@ void AVoxMeshThread::BuildGreedyMeshChunk(int32 StartZ, int32 EndZ, FVoxMeshData
                     const int32 Index = V2 + V1 * Dim2;
                     if (!Mask.IsValidIndex(Index)) continue;
 
-                    const int32 BlockIndex = Pos.X + Pos.Y * Dims.X + Pos.Z * DimXY;
-                    if (!VoxModel->Blocks.IsValidIndex(BlockIndex)) continue;
-
-                    const EBlock CurrentBlock = VoxModel->Blocks[BlockIndex];
-                    FIntVector NextPos = Pos + Normal;
-                    
-                    const bool InBounds = 
-                        NextPos.X >= 0 && NextPos.X < Dims.X &&
-                        NextPos.Y >= 0 && NextPos.Y < Dims.Y &&
-                        NextPos.Z >= 0 && NextPos.Z < Dims.Z;
-
-                    const EBlock NextBlock = InBounds
-                        ? VoxModel->Blocks[NextPos.X + NextPos.Y * Dims.X + NextPos.Z * DimXY]
-                        : EBlock::Air;
+                    EBlock CurrentBlock, NextBlock;
+                    Volume.GetWithNeighbour(Pos.X, Pos.Y, Pos.Z, Dir / 2, Normal[Dir / 2], CurrentBlock, NextBlock);
 
                     Mask[Index].Active = (CurrentBlock != EBlock::Air && NextBlock == EBlock::Air) ||
                         (CurrentBlock == EBlock::Air && NextBlock != EBlock::Air);
@@ -243,10 +298,11 @@ void AVoxMeshThread::BuildGreedyMeshChunk(int32 StartZ, int32 EndZ, FVoxMeshData
         }
     }
 
-    ChunkData.Vertices = MoveTemp(Vertices);
-    ChunkData.Triangles = MoveTemp(Triangles);
-    ChunkData.Normals = MoveTemp(MeshNormals);
-    ChunkData.UV0 = MoveTemp(UVs);
+    // Copied so the result is allocated at its exact size and the scratch keeps its memory
+    ChunkData.Vertices = Vertices;
+    ChunkData.Triangles = Triangles;
+    ChunkData.Normals = MeshNormals;
+    ChunkData.UV0 = UVs;
 }
 
 void AVoxMeshThread::GenerateFaceVertices(int32 Dir, const FVector& BasePos, const FVector& Size, 
@@ -324,17 +380,17 @@ void AVoxMeshThread::GenerateFaceIndices(int32 Dir, int32 StartVertex, TArray<in
     }
 }
 
-void AVoxMeshThread::VisualizeChunks()
+void AVoxMeshThread::VisualizeChunks(const AVoxModel* VoxModel) const
 {
     const int32 NumThreads = FPlatformMisc::NumberOfCores();
-    const int32 ChunkSize = FMath::Max(1, VoxModel->ModelDimensions.Z / NumThreads);
-    const float Scale = VoxModel->VoxelSize;
+    const int32 ChunkSize = FMath::Max(1, GridDimensions.Z / NumThreads);
+    const float Scale = VoxelSize;
     
     // Calculate model bounds
     const FVector ModelExtent(
-        VoxModel->ModelDimensions.X * Scale,
-        VoxModel->ModelDimensions.Y * Scale,
-        VoxModel->ModelDimensions.Z * Scale
+        GridDimensions.X * Scale,
+        GridDimensions.Y * Scale,
+        GridDimensions.Z * Scale
     );
     
     const FVector ModelOrigin = VoxModel->GetActorLocation() + FVector(
@@ -348,8 +404,8 @@ void AVoxMeshThread::VisualizeChunks()
     {
         const int32 StartZ = ThreadIndex * ChunkSize;
         const int32 EndZ = (ThreadIndex == NumThreads-1) ? 
-            VoxModel->ModelDimensions.Z : 
-            FMath::Min(StartZ + ChunkSize, VoxModel->ModelDimensions.Z);
+            GridDimensions.Z : 
+            FMath::Min(StartZ + ChunkSize, GridDimensions.Z);
 
         FVector ChunkMin = ModelOrigin + FVector(0, 0, StartZ * Scale);
         FVector ChunkMax = ModelOrigin + FVector(ModelExtent.X, ModelExtent.Y, EndZ * Scale);
@@ -386,6 +442,20 @@ void AVoxMeshThread::VisualizeChunks()
 
 void AVoxMeshThread::Exit()
 {
-	VoxModel->ApplyMesh();
+	// Releases the bricks shared with the model before the result waits in the queue
+	Volume.Reset();
+
+	const SIZE_T Bytes = Result->GetAllocatedSize();
+
+	UMeshApplySubsystem::Enqueue(WeakModel, ModelIndex, Revision, [Owner = WeakModel, Data = Result.ToSharedRef(),
+		                                                     ModelIndex = ModelIndex, Shared = SharedModel,
+		                                                     Revision = Revision]()
+	{
+		if (AVoxModel* Model = Owner.Get())
+		{
+			Model->ApplyMesh(*Data, ModelIndex, Shared, Revision);
+		}
+	}, Bytes);
+
 	FRunnable::Exit();
 }
@@ -2,22 +2,47 @@
 
 #include "CoreMinimal.h"
 #include "Enums.h"
+#include "VoxBlockVolume.h"
 #include "VoxMeshData.h"
 #include "VoxModel.h"
 
 class AVoxMeshThread : FRunnable
 {
 public:
-	AVoxMeshThread(AVoxModel* _VoxModel);
+	// Snapshots everything it reads from the model, the worker never touches the actor
+	AVoxMeshThread(AVoxModel* VoxModel, uint32 _Revision, int32 _ModelIndex = INDEX_NONE);
+
+	// Meshes on a pool thread, the task owns the job and frees it once the result is queued
+	static void Launch(AVoxModel* VoxModel, uint32 _Revision, int32 _ModelIndex = INDEX_NONE);
 
 	virtual bool Init() override;
 	virtual uint32 Run() override;
 	virtual void Exit() override;
-	void VisualizeChunks();
+	void VisualizeChunks(const AVoxModel* VoxModel) const;
 
 private:
 	FVoxMeshData VoxMeshData;
-	AVoxModel* VoxModel;
+
+	// Handed to the model, shared with the cache
+	TSharedPtr<const FVoxMeshData> Result;
+
+	// Set when the grid is meshed on behalf of every actor sharing it
+	TWeakPtr<FVoxSharedModel> SharedModel;
+
+	// Instanced models and unedited grids, the only ones looked up in and added to the cache
+	bool bFirstGeneration = true;
+
+	// The result is only handed back if the model still exists
+	TWeakObjectPtr<AVoxModel> WeakModel;
+	float VoxelSize;
+
+	// Unique model of an instanced scene, INDEX_NONE meshes the flattened grid
+	int32 ModelIndex;
+	FIntVector GridDimensions;
+
+	// Of the GenerateMesh call that started the job, see AVoxModel::ApplyMesh
+	uint32 Revision;
+	FVoxBlockVolume Volume;
 
 	// Main mesh generation methods
 	void BuildGreedyMeshParallel();
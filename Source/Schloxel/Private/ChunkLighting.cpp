@@ -0,0 +1,347 @@
+#include "ChunkLighting.h"
+
+#include "GreedyChunk.h"
+#include "VoxMemory.h"
+
+namespace
+{
+	// Down comes last, sky light uses it to keep full sunlight
+	const FIntVector Directions[] = {
+		FIntVector(1, 0, 0), FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0), FIntVector(0, -1, 0),
+		FIntVector(0, 0, 1), FIntVector(0, 0, -1)
+	};
+
+	constexpr int32 DownDirection = 5;
+
+	int32 FloorDiv(int32 Value, int32 Divisor)
+	{
+		return Value >= 0 ? Value / Divisor : (Value - Divisor + 1) / Divisor;
+	}
+
+	bool IsOpaque(EBlock Block)
+	{
+		return Block != EBlock::Air;
+	}
+}
+
+FChunkLighting::FChunkLighting(const TMap<FIntVector, AGreedyChunk*>& InChunks, const FIntVector& InChunkSize)
+	: Chunks(InChunks), ChunkSize(InChunkSize)
+{
+}
+
+bool FChunkLighting::Resolve(const FIntVector& Position, AGreedyChunk*& OutChunk, FIntVector& OutLocal) const
+{
+	const FIntVector ChunkCoord(
+		FloorDiv(Position.X, ChunkSize.X),
+		FloorDiv(Position.Y, ChunkSize.Y),
+		FloorDiv(Position.Z, ChunkSize.Z)
+	);
+
+	AGreedyChunk* const* Chunk = Chunks.Find(ChunkCoord);
+	if (!Chunk || !*Chunk)
+		return false;
+
+	OutChunk = *Chunk;
+	OutLocal = Position - ChunkCoord * ChunkSize;
+	return !OutChunk->Light.IsEmpty();
+}
+
+uint8 FChunkLighting::GetLevel(EChannel Channel, const AGreedyChunk* Chunk, const FIntVector& Local) const
+{
+	const uint8 Light = Chunk->Light.Get(Local);
+	return Channel == EChannel::Sky ? ChunkLight::GetSky(Light) : ChunkLight::GetBlock(Light);
+}
+
+void FChunkLighting::SetLevel(EChannel Channel, AGreedyChunk* Chunk, const FIntVector& Local, uint8 Level) const
+{
+	const uint8 Light = Chunk->Light.Get(Local);
+	Chunk->Light.Set(Local, Channel == EChannel::Sky ? (Light & 0x0F) | (Level << 4) : (Light & 0xF0) | Level);
+}
+
+uint8 FChunkLighting::GetLight(const FIntVector& Position) const
+{
+	AGreedyChunk* Chunk;
+	FIntVector Local;
+
+	return Resolve(Position, Chunk, Local) ? Chunk->Light.Get(Local) : ChunkLight::MaxLevel << 4;
+}
+
+void FChunkLighting::LightAll()
+{
+	// Light is stored per chunk next to its blocks
+	LLM_SCOPE_BYTAG(Voxel_Blocks);
+
+	TArray<FIntVector> SkyQueue;
+	TArray<FIntVector> BlockQueue;
+
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		AGreedyChunk* Chunk = Pair.Value;
+		const FIntVector Origin = Pair.Key * ChunkSize;
+
+		Chunk->Light.Init(ChunkSize, 0);
+
+		for (int32 x = 0; x < ChunkSize.X; x++)
+		{
+			for (int32 y = 0; y < ChunkSize.Y; y++)
+			{
+				bool bSkyVisible = !Chunks.Contains(Pair.Key + FIntVector(0, 0, 1));
+
+				for (int32 z = ChunkSize.Z - 1; z >= 0; z--)
+				{
+					const FIntVector Local(x, y, z);
+					const EBlock Block = Chunk->GetBlock(Local);
+
+					bSkyVisible &= !IsOpaque(Block);
+					if (bSkyVisible)
+					{
+						SetLevel(EChannel::Sky, Chunk, Local, ChunkLight::MaxLevel);
+						SkyQueue.Add(Origin + FIntVector(x, y, z));
+					}
+
+					if (const uint8 Emission = ChunkLight::GetEmission(Block))
+					{
+						SetLevel(EChannel::Block, Chunk, Local, Emission);
+						BlockQueue.Add(Origin + FIntVector(x, y, z));
+					}
+				}
+			}
+		}
+	}
+
+	Propagate(EChannel::Sky, SkyQueue, nullptr);
+	Propagate(EChannel::Block, BlockQueue, nullptr);
+
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		Pair.Value->Light.Compact();
+	}
+}
+
+void FChunkLighting::LightChunk(AGreedyChunk* Chunk, TSet<AGreedyChunk*>& OutDirtyChunks)
+{
+	LLM_SCOPE_BYTAG(Voxel_Blocks);
+
+	TArray<FIntVector> SkyQueue;
+	TArray<FIntVector> BlockQueue;
+
+	const FIntVector Origin = Chunk->ChunkCoord * ChunkSize;
+	Chunk->Light.Init(ChunkSize, 0);
+
+	for (int32 x = 0; x < ChunkSize.X; x++)
+	{
+		for (int32 y = 0; y < ChunkSize.Y; y++)
+		{
+			// Full sunlight from above keeps falling, open sky above the loaded chunks included
+			bool bSkyVisible = ChunkLight::GetSky(GetLight(Origin + FIntVector(x, y, ChunkSize.Z))) == ChunkLight::MaxLevel;
+
+			for (int32 z = ChunkSize.Z - 1; z >= 0; z--)
+			{
+				const FIntVector Local(x, y, z);
+				const EBlock Block = Chunk->GetBlock(Local);
+
+				bSkyVisible &= !IsOpaque(Block);
+				if (bSkyVisible)
+				{
+					SetLevel(EChannel::Sky, Chunk, Local, ChunkLight::MaxLevel);
+					SkyQueue.Add(Origin + FIntVector(x, y, z));
+				}
+
+				if (const uint8 Emission = ChunkLight::GetEmission(Block))
+				{
+					SetLevel(EChannel::Block, Chunk, Local, Emission);
+					BlockQueue.Add(Origin + FIntVector(x, y, z));
+				}
+			}
+		}
+	}
+
+	// The neighbours spread their light in across the faces
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const int32 Axis1 = (Axis + 1) % 3;
+		const int32 Axis2 = (Axis + 2) % 3;
+
+		for (const int32 Side : {-1, ChunkSize[Axis]})
+		{
+			for (int32 i = 0; i < ChunkSize[Axis1]; i++)
+			{
+				for (int32 j = 0; j < ChunkSize[Axis2]; j++)
+				{
+					FIntVector Neighbour;
+					Neighbour[Axis] = Side;
+					Neighbour[Axis1] = i;
+					Neighbour[Axis2] = j;
+
+					SkyQueue.Add(Origin + Neighbour);
+					BlockQueue.Add(Origin + Neighbour);
+				}
+			}
+		}
+	}
+
+	Propagate(EChannel::Sky, SkyQueue, &OutDirtyChunks);
+	Propagate(EChannel::Block, BlockQueue, &OutDirtyChunks);
+
+	Chunk->Light.Compact();
+	Compact(OutDirtyChunks);
+}
+
+void FChunkLighting::UpdateBlocks(const TArray<FIntVector>& Changed, TSet<AGreedyChunk*>& OutDirtyChunks)
+{
+	for (const EChannel Channel : {EChannel::Sky, EChannel::Block})
+	{
+		TArray<FRemovalNode> RemovalQueue;
+		TArray<FIntVector> RefillQueue;
+
+		for (const FIntVector& Position : Changed)
+		{
+			AGreedyChunk* Chunk;
+			FIntVector Local;
+			if (!Resolve(Position, Chunk, Local))
+				continue;
+
+			OutDirtyChunks.Add(Chunk);
+
+			// Whatever lit this cell before may be gone now, the removal pass sorts out what comes back
+			if (const uint8 Level = GetLevel(Channel, Chunk, Local))
+			{
+				SetLevel(Channel, Chunk, Local, 0);
+				RemovalQueue.Add({Position, Level});
+			}
+			else if (const uint8 Emission = Channel == EChannel::Block ? ChunkLight::GetEmission(Chunk->GetBlock(Local)) : 0)
+			{
+				SetLevel(Channel, Chunk, Local, Emission);
+				RefillQueue.Add(Position);
+			}
+
+			if (IsOpaque(Chunk->GetBlock(Local)))
+				continue;
+
+			// A new hole pulls light in from its neighbours, or straight from the sky at the top of the world
+			AGreedyChunk* AboveChunk;
+			FIntVector AboveLocal;
+			if (Channel == EChannel::Sky && !Resolve(Position + FIntVector(0, 0, 1), AboveChunk, AboveLocal))
+			{
+				SetLevel(Channel, Chunk, Local, ChunkLight::MaxLevel);
+				RefillQueue.Add(Position);
+			}
+
+			for (const FIntVector& Direction : Directions)
+			{
+				RefillQueue.Add(Position + Direction);
+			}
+		}
+
+		Remove(Channel, RemovalQueue, RefillQueue, &OutDirtyChunks);
+		Propagate(Channel, RefillQueue, &OutDirtyChunks);
+	}
+
+	Compact(OutDirtyChunks);
+}
+
+void FChunkLighting::Compact(const TSet<AGreedyChunk*>& LitChunks) const
+{
+	for (AGreedyChunk* Chunk : LitChunks)
+	{
+		Chunk->Light.Compact();
+	}
+}
+
+void FChunkLighting::Remove(EChannel Channel, TArray<FRemovalNode>& Queue, TArray<FIntVector>& OutRefill,
+                            TSet<AGreedyChunk*>* DirtyChunks) const
+{
+	for (int32 Head = 0; Head < Queue.Num(); Head++)
+	{
+		const FRemovalNode Node = Queue[Head];
+
+		// Emitters relight themselves once the darkness has passed
+		AGreedyChunk* NodeChunk;
+		FIntVector NodeLocal;
+		if (Channel == EChannel::Block && Resolve(Node.Position, NodeChunk, NodeLocal))
+		{
+			if (const uint8 Emission = ChunkLight::GetEmission(NodeChunk->GetBlock(NodeLocal)))
+			{
+				SetLevel(Channel, NodeChunk, NodeLocal, Emission);
+				OutRefill.Add(Node.Position);
+			}
+		}
+
+		for (int32 Dir = 0; Dir < 6; Dir++)
+		{
+			const FIntVector Next = Node.Position + Directions[Dir];
+
+			AGreedyChunk* Chunk;
+			FIntVector Local;
+			if (!Resolve(Next, Chunk, Local))
+				continue;
+
+			const uint8 Level = GetLevel(Channel, Chunk, Local);
+			if (Level == 0)
+				continue;
+
+			const bool bSunColumn = Channel == EChannel::Sky && Dir == DownDirection &&
+				Node.Level == ChunkLight::MaxLevel;
+
+			if (Level < Node.Level || bSunColumn)
+			{
+				SetLevel(Channel, Chunk, Local, 0);
+				Queue.Add({Next, Level});
+
+				if (DirtyChunks)
+				{
+					DirtyChunks->Add(Chunk);
+				}
+			}
+			else
+			{
+				// Lit from somewhere else, it spreads back into the removed area
+				OutRefill.Add(Next);
+			}
+		}
+	}
+}
+
+void FChunkLighting::Propagate(EChannel Channel, TArray<FIntVector>& Queue, TSet<AGreedyChunk*>* DirtyChunks) const
+{
+	for (int32 Head = 0; Head < Queue.Num(); Head++)
+	{
+		const FIntVector Position = Queue[Head];
+
+		AGreedyChunk* Chunk;
+		FIntVector Local;
+		if (!Resolve(Position, Chunk, Local))
+			continue;
+
+		const uint8 Level = GetLevel(Channel, Chunk, Local);
+		if (Level <= 1)
+			continue;
+
+		for (int32 Dir = 0; Dir < 6; Dir++)
+		{
+			const FIntVector Next = Position + Directions[Dir];
+
+			AGreedyChunk* NextChunk;
+			FIntVector NextLocal;
+			if (!Resolve(Next, NextChunk, NextLocal) || IsOpaque(NextChunk->GetBlock(NextLocal)))
+				continue;
+
+			// Full sunlight falls straight down without losing strength
+			const uint8 NextLevel = Channel == EChannel::Sky && Dir == DownDirection && Level == ChunkLight::MaxLevel
+				                        ? ChunkLight::MaxLevel
+				                        : Level - 1;
+
+			if (GetLevel(Channel, NextChunk, NextLocal) >= NextLevel)
+				continue;
+
+			SetLevel(Channel, NextChunk, NextLocal, NextLevel);
+			Queue.Add(Next);
+
+			if (DirtyChunks)
+			{
+				DirtyChunks->Add(NextChunk);
+			}
+		}
+	}
+}
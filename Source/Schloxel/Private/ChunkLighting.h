@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Enums.h"
+
+class AGreedyChunk;
+
+// Each voxel stores two 4 bit light levels, sky light in the high nibble and block light in the low one
+namespace ChunkLight
+{
+	constexpr uint8 MaxLevel = 15;
+
+	inline uint8 GetSky(uint8 Light) { return Light >> 4; }
+	inline uint8 GetBlock(uint8 Light) { return Light & 0xF; }
+
+	inline uint8 GetEmission(EBlock Block)
+	{
+		return Block == EBlock::Lamp ? 14 : 0;
+	}
+}
+
+/**
+ * Flood fills sky and block light through the chunks of a world with BFS queues. Positions are in world
+ * voxel space, so light crosses chunk borders freely. Game thread only.
+ */
+class FChunkLighting
+{
+public:
+	FChunkLighting(const TMap<FIntVector, AGreedyChunk*>& InChunks, const FIntVector& InChunkSize);
+
+	// Seeds sky columns and emitters of every chunk and spreads them
+	void LightAll();
+
+	// Lights a chunk added after LightAll from its own blocks and the light of its neighbours. Adds every chunk
+	// the light reached to OutDirtyChunks.
+	void LightChunk(AGreedyChunk* Chunk, TSet<AGreedyChunk*>& OutDirtyChunks);
+
+	// Blocks at these positions were already changed. Removes the light they cut off and refills the holes.
+	void UpdateBlocks(const TArray<FIntVector>& Changed, TSet<AGreedyChunk*>& OutDirtyChunks);
+
+	// Packed light of any position, open sky outside the loaded chunks
+	uint8 GetLight(const FIntVector& Position) const;
+
+private:
+	enum class EChannel : uint8 { Sky, Block };
+
+	struct FRemovalNode
+	{
+		FIntVector Position;
+		uint8 Level;
+	};
+
+	// Chunk holding a world position and the position inside it
+	bool Resolve(const FIntVector& Position, AGreedyChunk*& OutChunk, FIntVector& OutLocal) const;
+
+	uint8 GetLevel(EChannel Channel, const AGreedyChunk* Chunk, const FIntVector& Local) const;
+	void SetLevel(EChannel Channel, AGreedyChunk* Chunk, const FIntVector& Local, uint8 Level) const;
+
+	// Bricks that became uniform again give their voxels back
+	void Compact(const TSet<AGreedyChunk*>& LitChunks) const;
+
+	void Remove(EChannel Channel, TArray<FRemovalNode>& Queue, TArray<FIntVector>& OutRefill,
+	            TSet<AGreedyChunk*>* DirtyChunks) const;
+	void Propagate(EChannel Channel, TArray<FIntVector>& Queue, TSet<AGreedyChunk*>* DirtyChunks) const;
+
+	const TMap<FIntVector, AGreedyChunk*>& Chunks;
+	FIntVector ChunkSize;
+};
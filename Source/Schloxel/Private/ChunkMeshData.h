@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
 #include "ChunkMeshData.generated.h"
 
 USTRUCT()
@@ -15,5 +16,40 @@ struct FChunkMeshData
 	TArray<FVector> Normals;
 	TArray<FColor> Colors;
 	TArray<FVector2D> UV0;
+
+	// EBlockDirection of every triangle, each direction becomes its own polygroup
+	TArray<uint8> TriangleDirections;
+
+	// Bounds of the faces of each direction, invalid if the direction has none
+	TStaticArray<FBox, 6> DirectionBounds = TStaticArray<FBox, 6>(InPlace, ForceInit);
+
+	// Solid boxes in local space, used as simple collision instead of cooking the triangles
+	TArray<FBox> CollisionBoxes;
+
+	// Bit A * 6 + B is set when EBlockDirection faces A and B of the chunk see each other through air
+	uint64 FaceConnections = ~0ull;
+
 	int VertexCount = 0;
+
+	// Empties the mesh without giving memory back
+	void Reset()
+	{
+		Vertices.Reset();
+		Triangles.Reset();
+		Normals.Reset();
+		Colors.Reset();
+		UV0.Reset();
+		TriangleDirections.Reset();
+		CollisionBoxes.Reset();
+		DirectionBounds = TStaticArray<FBox, 6>(InPlace, ForceInit);
+		FaceConnections = ~0ull;
+		VertexCount = 0;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Vertices.GetAllocatedSize() + Triangles.GetAllocatedSize() + Normals.GetAllocatedSize() +
+			Colors.GetAllocatedSize() + UV0.GetAllocatedSize() + TriangleDirections.GetAllocatedSize() +
+			CollisionBoxes.GetAllocatedSize();
+	}
 };
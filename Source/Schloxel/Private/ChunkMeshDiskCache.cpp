@@ -0,0 +1,212 @@
+#include "ChunkMeshDiskCache.h"
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 Magic = 0x434D5856; // VXMC
+
+	// Last save of each file by any cache, a new cache for the same settings reads only once it is written
+	FCriticalSection SavesLock;
+	TMap<FString, TSharedFuture<void>> LastSaves;
+
+	TSharedFuture<void> FindLastSave(const FString& Path)
+	{
+		FScopeLock Lock(&SavesLock);
+		return LastSaves.FindRef(Path);
+	}
+
+	void SerializeMeshData(FArchive& Ar, FChunkMeshData& Data)
+	{
+		Ar << Data.Vertices;
+		Ar << Data.Triangles;
+		Ar << Data.Normals;
+		Ar << Data.Colors;
+		Ar << Data.UV0;
+		Ar << Data.TriangleDirections;
+
+		for (FBox& Bounds : Data.DirectionBounds)
+		{
+			Ar << Bounds;
+		}
+
+		Ar << Data.CollisionBoxes;
+		Ar << Data.FaceConnections;
+		Ar << Data.VertexCount;
+	}
+}
+
+FChunkMeshDiskCache::FChunkMeshDiskCache(uint64 InSettingsKey)
+	: Path(FPaths::ProjectSavedDir() / TEXT("VoxelMeshCache") / FString::Printf(TEXT("%016llx.bin"), InSettingsKey))
+	, SettingsKey(InSettingsKey)
+{
+	LoadTask = Async(EAsyncExecution::ThreadPool, [this, PendingSave = FindLastSave(Path)]()
+	{
+		if (PendingSave.IsValid())
+		{
+			PendingSave.Wait();
+		}
+
+		TArray<uint8> Bytes;
+		if (!FFileHelper::LoadFileToArray(Bytes, *Path, FILEREAD_Silent))
+			return;
+
+		FMemoryReader Reader(Bytes);
+
+		uint32 FileMagic = 0;
+		int32 FileVersion = 0;
+		uint64 FileSettingsKey = 0;
+		int32 NumEntries = 0;
+		Reader << FileMagic << FileVersion << FileSettingsKey << NumEntries;
+
+		if (FileMagic != Magic || FileVersion != Version || FileSettingsKey != SettingsKey || NumEntries < 0)
+		{
+			UE_LOG(LogTemp, Display, TEXT("Ignoring stale voxel mesh cache %s"), *Path);
+			return;
+		}
+
+		TMap<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>> Entries;
+		Entries.Reserve(NumEntries);
+
+		for (int32 Entry = 0; Entry < NumEntries && !Reader.IsError(); Entry++)
+		{
+			FChunkMeshCacheKey Key;
+			Reader << Key;
+
+			const TSharedRef<FChunkMeshData> Data = MakeShared<FChunkMeshData>();
+			SerializeMeshData(Reader, *Data);
+			Entries.Add(Key, Data);
+		}
+
+		if (Reader.IsError())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Voxel mesh cache %s is corrupt, meshing from scratch"), *Path);
+			return;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Read %d chunk meshes from %s"), Entries.Num(), *Path);
+
+		FScopeLock Lock(&CacheLock);
+		Loaded = MoveTemp(Entries);
+	});
+}
+
+FChunkMeshDiskCache::~FChunkMeshDiskCache()
+{
+	LoadTask.Wait();
+}
+
+TSharedPtr<const FChunkMeshData> FChunkMeshDiskCache::Find(const FChunkMeshCacheKey& Key)
+{
+	LoadTask.Wait();
+
+	FScopeLock Lock(&CacheLock);
+
+	if (const TSharedPtr<const FChunkMeshData>* Found = Used.Find(Key))
+		return *Found;
+
+	TSharedPtr<const FChunkMeshData> Data;
+	if (Loaded.RemoveAndCopyValue(Key, Data))
+	{
+		Used.Add(Key, Data);
+	}
+	return Data;
+}
+
+void FChunkMeshDiskCache::Add(const FChunkMeshCacheKey& Key, const TSharedPtr<const FChunkMeshData>& Data)
+{
+	FScopeLock Lock(&CacheLock);
+
+	if (Used.Contains(Key))
+		return;
+
+	// Anything not already in the file makes it worth writing again
+	bDirty |= Loaded.Remove(Key) == 0;
+	Used.Add(Key, Data);
+}
+
+SIZE_T FChunkMeshDiskCache::GetAllocatedSize(TSet<const void*>& CountedData)
+{
+	LoadTask.Wait();
+
+	FScopeLock Lock(&CacheLock);
+
+	SIZE_T Size = Loaded.GetAllocatedSize() + Used.GetAllocatedSize();
+
+	for (const TMap<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>>* Entries : {&Loaded, &Used})
+	{
+		for (const TPair<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>>& Pair : *Entries)
+		{
+			bool bAlreadyCounted = false;
+			CountedData.Add(Pair.Value.Get(), &bAlreadyCounted);
+
+			if (!bAlreadyCounted)
+			{
+				Size += Pair.Value->GetAllocatedSize();
+			}
+		}
+	}
+
+	return Size;
+}
+
+void FChunkMeshDiskCache::Save()
+{
+	LoadTask.Wait();
+
+	TArray<TPair<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>>> Entries;
+	{
+		FScopeLock Lock(&CacheLock);
+
+		if (!bDirty)
+			return;
+
+		// Entries nobody asked for yet are kept, the session may have ended before their chunks were meshed
+		Entries.Reserve(Used.Num() + Loaded.Num());
+		Entries.Append(Used.Array());
+		Entries.Append(Loaded.Array());
+
+		bDirty = false;
+	}
+
+	FScopeLock SaveLock(&SavesLock);
+	TSharedFuture<void>& LastSave = LastSaves.FindOrAdd(Path);
+
+	LastSave = Async(EAsyncExecution::ThreadPool, [Previous = LastSave, Entries = MoveTemp(Entries), Path = Path,
+		                                           SettingsKey = SettingsKey]() mutable
+	{
+		// An older save of the same file would otherwise finish last, even one of an earlier cache
+		if (Previous.IsValid())
+		{
+			Previous.Wait();
+		}
+
+		TArray<uint8> Bytes;
+		FMemoryWriter Writer(Bytes);
+
+		uint32 FileMagic = Magic;
+		int32 FileVersion = Version;
+		uint64 FileSettingsKey = SettingsKey;
+		int32 NumEntries = Entries.Num();
+		Writer << FileMagic << FileVersion << FileSettingsKey << NumEntries;
+
+		for (TPair<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>>& Pair : Entries)
+		{
+			Writer << Pair.Key;
+			SerializeMeshData(Writer, const_cast<FChunkMeshData&>(*Pair.Value));
+		}
+
+		// Written next to the file and moved over it, a reader never sees half a file
+		const FString TempPath = Path + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Could not write voxel mesh cache %s"), *Path);
+			IFileManager::Get().Delete(*TempPath);
+		}
+	}).Share();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "ChunkMeshData.h"
+
+// Chunks are generated from the world settings alone, so under one settings key a chunk's mesh is known from
+// its coordinate and the edit revision it was meshed at, before it is lit or its voxels are hashed
+struct FChunkMeshCacheKey
+{
+	FIntVector Coord = FIntVector::ZeroValue;
+	int32 EditRevision = 0;
+
+	bool operator==(const FChunkMeshCacheKey& Other) const
+	{
+		return Coord == Other.Coord && EditRevision == Other.EditRevision;
+	}
+
+	friend uint32 GetTypeHash(const FChunkMeshCacheKey& Key)
+	{
+		return HashCombine(GetTypeHash(Key.Coord), GetTypeHash(Key.EditRevision));
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FChunkMeshCacheKey& Key)
+	{
+		return Ar << Key.Coord << Key.EditRevision;
+	}
+};
+
+/**
+ * Chunk meshes of one set of world settings kept in Saved/VoxelMeshCache between launches, one file per
+ * settings key. The file is read on the thread pool as soon as the cache is made, lookups wait for it. It is
+ * only written again when the session meshed something it didn't have, also on the thread pool.
+ */
+class FChunkMeshDiskCache
+{
+public:
+	explicit FChunkMeshDiskCache(uint64 InSettingsKey);
+	~FChunkMeshDiskCache();
+
+	// Thread safe, blocks until the file has been read
+	TSharedPtr<const FChunkMeshData> Find(const FChunkMeshCacheKey& Key);
+
+	// Thread safe
+	void Add(const FChunkMeshCacheKey& Key, const TSharedPtr<const FChunkMeshData>& Data);
+
+	// Bytes of the entries not in CountedData yet, which are added to it. Blocks until the file has been read.
+	SIZE_T GetAllocatedSize(TSet<const void*>& CountedData);
+
+	// Writes the file on the thread pool if anything was added since it was read. The entries are shared with
+	// the task, so the cache can be destroyed while it runs. Saves of a file are written one after another and
+	// a cache made for the same file reads it only once they are done.
+	void Save();
+
+private:
+	// Bumped whenever FChunkMeshData, the key or the mesher output changes, older files are ignored
+	static constexpr int32 Version = 2;
+
+	FString Path;
+	uint64 SettingsKey;
+
+	TFuture<void> LoadTask;
+
+	FCriticalSection CacheLock;
+
+	// Read from disk, moved to Used on the first hit
+	TMap<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>> Loaded;
+	TMap<FChunkMeshCacheKey, TSharedPtr<const FChunkMeshData>> Used;
+
+	bool bDirty = false;
+};
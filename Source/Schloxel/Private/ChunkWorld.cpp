@@ -3,15 +3,62 @@
 
 #include "ChunkWorld.h"
 
+#include "ChunkMeshDiskCache.h"
 #include "GreedyChunk.h"
+#include "MeshApplySubsystem.h"
+#include "Async/Async.h"
+#include "VoxMemory.h"
+#include "RealtimeMeshComponent.h"
+#include "RealtimeMeshSimple.h"
 #include "MyUserWidget.h"
 #include "Kismet/GameplayStatics.h"
+#include "EngineUtils.h"
+#include "Engine/GameInstance.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Hash/CityHash.h"
+
+namespace
+{
+	// Indexed by EBlockDirection
+	const FIntVector ChunkSteps[] = {
+		FIntVector(1, 0, 0), FIntVector(0, 1, 0), FIntVector(-1, 0, 0),
+		FIntVector(0, -1, 0), FIntVector(0, 0, 1), FIntVector(0, 0, -1)
+	};
+
+	constexpr int32 OppositeDirection[] = {2, 3, 0, 1, 5, 4};
+
+	int32 FloorDiv(int32 Value, int32 Divisor)
+	{
+		return Value >= 0 ? Value / Divisor : (Value - Divisor + 1) / Divisor;
+	}
+}
+
+static bool GChunkOcclusionCulling = true;
+static FAutoConsoleVariableRef CVarChunkOcclusionCulling(
+	TEXT("vox.ChunkOcclusionCulling"),
+	GChunkOcclusionCulling,
+	TEXT("Hide chunks the player view can't reach through the open space between chunk faces."));
+
+static float GRegionSlack = 0.25f;
+static FAutoConsoleVariableRef CVarRegionSlack(
+	TEXT("vox.RegionSlack"),
+	GRegionSlack,
+	TEXT("Spare vertices and triangles reserved per chunk in region meshes, as a fraction of its mesh. Remeshed chunks that fit are written in place instead of rebuilding the region."));
+
+static bool GFaceDirectionCulling = true;
+static FAutoConsoleVariableRef CVarFaceDirectionCulling(
+	TEXT("vox.FaceDirectionCulling"),
+	GFaceDirectionCulling,
+	TEXT("Leave the face direction sections of chunks that point away from the player view out of the main pass. Shadows still use them. Scene captures from other places see the same culled sections, turn this off for them."));
 
 // Sets default values
 AChunkWorld::AChunkWorld()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = false;
+	// Ticks to cull its chunks and their face directions against the player view
+	PrimaryActorTick.bCanEverTick = true;
 }
 
 #if WITH_EDITOR
@@ -31,6 +78,12 @@ void AChunkWorld::RegenerateChunks()
 	// Precompute brightness for the heightmap
 	PrecomputeBrightness(HeightMap);
 
+	// Read while the chunks generate and light, the first mesh job waits for it
+	if (bPersistMeshCache)
+	{
+		MeshDiskCache = MakeShared<FChunkMeshDiskCache, ESPMode::ThreadSafe>(GetMeshCacheSettingsKey());
+	}
+
 	SpawnChunks();
 }
 #endif
@@ -43,40 +96,914 @@ void AChunkWorld::BeginPlay()
 	RegenerateChunks();
 }
 
+void AChunkWorld::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// The chunks go away with the world, the light task must not outlive them
+	EnsureLighting();
+
+	if (MeshDiskCache)
+	{
+		MeshDiskCache->Save();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+uint64 AChunkWorld::GetMeshCacheSettingsKey() const
+{
+	const FString PathName = HeightMap ? HeightMap->GetPathName() : FString();
+	uint64 Key = CityHash64(reinterpret_cast<const char*>(*PathName), PathName.Len() * sizeof(TCHAR));
+
+	// Changes whenever the heightmap source is reimported or edited
+	const FGuid HeightMapGuid = HeightMap ? HeightMap->GetLightingGuid() : FGuid();
+	Key = CityHash64WithSeed(reinterpret_cast<const char*>(&HeightMapGuid), sizeof(HeightMapGuid), Key);
+
+	const int32 Settings[] = {ChunkSize.X, ChunkSize.Y, ChunkSize.Z, VoxelSize, DrawDistance};
+	return CityHash64WithSeed(reinterpret_cast<const char*>(Settings), sizeof(Settings), Key);
+}
+
 void AChunkWorld::SpawnChunks()
 {
+	// Terrain height range under every chunk column, the chunks stack up to the highest point
+	TArray<FIntPoint> ColumnHeights;
+	ColumnHeights.SetNum(DrawDistance * DrawDistance);
+
+	int32 MaxHeight = 0;
+
 	for (int x = 0; x < DrawDistance; x++)
 	{
 		for (int y = 0; y < DrawDistance; y++)
 		{
-			auto transform = FTransform(
-				FRotator::ZeroRotator,
-				FVector(x * ChunkSize.X * VoxelSize, y * ChunkSize.Y * VoxelSize, 0),
-				FVector::OneVector
-			);
+			FIntPoint& Range = ColumnHeights[x + y * DrawDistance];
+			Range = FIntPoint(MAX_int32, 0);
+
+			for (int VoxelX = x * ChunkSize.X; VoxelX < (x + 1) * ChunkSize.X; VoxelX++)
+			{
+				for (int VoxelY = y * ChunkSize.Y; VoxelY < (y + 1) * ChunkSize.Y; VoxelY++)
+				{
+					const int* Brightness = CachedBrightnessMap.Find(FIntPoint(VoxelX, VoxelY));
+					const int32 Height = Brightness ? *Brightness : 0;
+
+					Range.X = FMath::Min(Range.X, Height);
+					Range.Y = FMath::Max(Range.Y, Height);
+				}
+			}
+
+			MaxHeight = FMath::Max(MaxHeight, Range.Y);
+		}
+	}
+
+	const int VerticalChunks = FMath::Max(1, FMath::DivideAndRoundUp(MaxHeight, ChunkSize.Z));
+
+	for (int x = 0; x < DrawDistance; x++)
+	{
+		for (int y = 0; y < DrawDistance; y++)
+		{
+			const FIntPoint& Range = ColumnHeights[x + y * DrawDistance];
+
+			for (int z = 0; z < VerticalChunks; z++)
+			{
+				// All air or all stone, nothing to store, light or mesh
+				if (Range.Y <= z * ChunkSize.Z)
+					continue;
+
+				if (Range.X >= (z + 1) * ChunkSize.Z)
+				{
+					SolidChunks.Add(FIntVector(x, y, z));
+					continue;
+				}
+
+				SpawnChunk(FIntVector(x, y, z));
+			}
+		}
+	}
+
+	ChunkMin = FIntVector::ZeroValue;
+	ChunkMax = FIntVector(DrawDistance - 1, DrawDistance - 1, VerticalChunks - 1);
+
+	Lighting = MakeUnique<FChunkLighting>(Chunks, ChunkSize);
+
+	// Warm start, every mesh is already known from the coordinate alone. Light is only needed once an edit
+	// relights or remeshes something, the blocks stay untouched until then, so it is worked out in the background.
+	if (ApplyCachedMeshes())
+	{
+		LightingTask = Async(EAsyncExecution::ThreadPool, [Lighting = Lighting.Get()]()
+		{
+			Lighting->LightAll();
+		});
+		return;
+	}
+
+	// Light crosses chunk borders, so every chunk is lit before any of them is meshed
+	Lighting->LightAll();
+
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		Pair.Value->GenerateMesh();
+	}
+}
+
+bool AChunkWorld::ApplyCachedMeshes()
+{
+	if (!MeshDiskCache)
+		return false;
+
+	TArray<TPair<AGreedyChunk*, TSharedPtr<const FChunkMeshData>>> Cached;
+	Cached.Reserve(Chunks.Num());
+
+	// Waits for the file, it was read while the chunks spawned
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		TSharedPtr<const FChunkMeshData> Data = MeshDiskCache->Find({Pair.Key, 0});
+		if (!Data)
+			return false;
+
+		Cached.Emplace(Pair.Value, MoveTemp(Data));
+	}
+
+	// Applied within the same budget as finished mesh jobs
+	for (TPair<AGreedyChunk*, TSharedPtr<const FChunkMeshData>>& Pair : Cached)
+	{
+		const uint32 Revision = Pair.Key->NewMeshRevision();
+
+		UMeshApplySubsystem::Enqueue(Pair.Key, 0, Revision,
+		                             [Owner = TWeakObjectPtr<AGreedyChunk>(Pair.Key), Data = MoveTemp(Pair.Value),
+			                             Revision]()
+		                             {
+			                             if (AGreedyChunk* Chunk = Owner.Get())
+			                             {
+				                             Chunk->ApplyMesh(Data.ToSharedRef(), Revision);
+			                             }
+		                             });
+	}
+
+	return true;
+}
+
+void AChunkWorld::EnsureLighting() const
+{
+	if (!LightingTask.IsValid())
+		return;
+
+	// Same light the cached meshes were built with, nothing needs remeshing
+	LightingTask.Wait();
+	LightingTask.Reset();
+}
+
+AGreedyChunk* AChunkWorld::SpawnChunk(const FIntVector& Coord)
+{
+	const FTransform Transform(
+		FRotator::ZeroRotator,
+		FVector(Coord.X * ChunkSize.X * VoxelSize, Coord.Y * ChunkSize.Y * VoxelSize, Coord.Z * ChunkSize.Z * VoxelSize),
+		FVector::OneVector
+	);
+
+	auto chunk = GetWorld()->SpawnActorDeferred<AGreedyChunk>(AGreedyChunk::StaticClass(), Transform, this);
+	chunk->Material = Material;
+	chunk->ChunkSize = ChunkSize;
+	chunk->VoxelSize = VoxelSize;
+	chunk->CachedBrightnessMap = &CachedBrightnessMap;
+	chunk->ChunkWorld = this;
+	chunk->ChunkCoord = Coord;
+
+	// The collision rings hand it out
+	if (CollisionRadius > 0)
+	{
+		chunk->GetMeshComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+
+	UGameplayStatics::FinishSpawningActor(chunk, Transform);
+
+	SpawnedChunks.Add(chunk);
+	Chunks.Add(Coord, chunk);
+	return chunk;
+}
+
+AGreedyChunk* AChunkWorld::MaterializeChunk(const FIntVector& Coord, TSet<AGreedyChunk*>& OutDirtyChunks)
+{
+	// The heightmap gives it the same uniform block it was elided for
+	SolidChunks.Remove(Coord);
+	AGreedyChunk* Chunk = SpawnChunk(Coord);
+
+	if (Lighting)
+	{
+		Lighting->LightChunk(Chunk, OutDirtyChunks);
+	}
+
+	OutDirtyChunks.Add(Chunk);
+	return Chunk;
+}
+
+FIntVector AChunkWorld::GetChunkCoord(const FIntVector& WorldVoxel) const
+{
+	return FIntVector(FloorDiv(WorldVoxel.X, ChunkSize.X), FloorDiv(WorldVoxel.Y, ChunkSize.Y),
+	                  FloorDiv(WorldVoxel.Z, ChunkSize.Z));
+}
+
+FIntVector AChunkWorld::GetVoxel(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / VoxelSize), FMath::FloorToInt(Location.Y / VoxelSize),
+	                  FMath::FloorToInt(Location.Z / VoxelSize));
+}
+
+void AChunkWorld::ModifyVoxel(const FIntVector& WorldVoxel, EBlock Block)
+{
+	constexpr int Radius = AGreedyChunk::BrushRadius;
+
+	EnsureLighting();
+
+	TMap<AGreedyChunk*, TArray<FIntVector>> Changed;
+	TSet<AGreedyChunk*> DirtyChunks;
+
+	for (int x = -Radius + 1; x <= Radius - 1; ++x)
+	{
+		for (int y = -Radius + 1; y <= Radius - 1; ++y)
+		{
+			for (int z = -Radius + 1; z <= Radius - 1; ++z)
+			{
+				if (FVector(x, y, z).Size() > Radius)
+					continue;
 
-			AActor* NewChunk = nullptr;
+				const FIntVector Voxel = WorldVoxel + FIntVector(x, y, z);
+				const FIntVector Coord = GetChunkCoord(Voxel);
 
-			auto chunk = GetWorld()->SpawnActorDeferred<AGreedyChunk>(AGreedyChunk::StaticClass(), transform, this);
-			chunk->Material = Material;
-			chunk->ChunkSize = ChunkSize;
-			chunk->VoxelSize = VoxelSize;
-			chunk->CachedBrightnessMap = &CachedBrightnessMap;
+				AGreedyChunk* Chunk = Chunks.FindRef(Coord);
 
-			UGameplayStatics::FinishSpawningActor(chunk, transform);
-			NewChunk = chunk;
+				if (!Chunk)
+				{
+					// Beyond the world, or an elided chunk that already is what the brush paints
+					if (Coord.X < ChunkMin.X || Coord.Y < ChunkMin.Y || Coord.Z < ChunkMin.Z ||
+						Coord.X > ChunkMax.X || Coord.Y > ChunkMax.Y || Coord.Z > ChunkMax.Z)
+						continue;
 
-			if (NewChunk)
+					if (Block == (SolidChunks.Contains(Coord) ? EBlock::Stone : EBlock::Air))
+						continue;
+
+					Chunk = MaterializeChunk(Coord, DirtyChunks);
+				}
+
+				const FIntVector Local = Voxel - Coord * ChunkSize;
+
+				if (Chunk->GetBlock(Local) != Block)
+				{
+					Chunk->SetBlock(Local, Block);
+					Changed.FindOrAdd(Chunk).Add(Local);
+				}
+			}
+		}
+	}
+
+	if (Changed.IsEmpty())
+		return;
+
+	// Digging up to an elided solid chunk exposes faces only that chunk can mesh
+	if (Block == EBlock::Air)
+	{
+		for (const TPair<AGreedyChunk*, TArray<FIntVector>>& Pair : Changed)
+		{
+			const FIntVector Origin = Pair.Key->ChunkCoord * ChunkSize;
+
+			for (const FIntVector& Local : Pair.Value)
 			{
-				SpawnedChunks.Add(NewChunk);
+				for (const FIntVector& Step : ChunkSteps)
+				{
+					const FIntVector Coord = GetChunkCoord(Origin + Local + Step);
+
+					if (Coord != Pair.Key->ChunkCoord && SolidChunks.Contains(Coord))
+					{
+						MaterializeChunk(Coord, DirtyChunks);
+					}
+				}
 			}
 		}
 	}
+
+	OnBlocksChanged(Changed, DirtyChunks);
+}
+
+void AChunkWorld::OnBlocksChanged(const TMap<AGreedyChunk*, TArray<FIntVector>>& Changed,
+                                  TSet<AGreedyChunk*>& DirtyChunks)
+{
+	++EditRevision;
+
+	TArray<FIntVector> WorldPositions;
+
+	for (const TPair<AGreedyChunk*, TArray<FIntVector>>& Pair : Changed)
+	{
+		DirtyChunks.Add(Pair.Key);
+
+		for (const FIntVector& Position : Pair.Value)
+		{
+			WorldPositions.Add(Pair.Key->ChunkCoord * ChunkSize + Position);
+		}
+	}
+
+	if (Lighting)
+	{
+		Lighting->UpdateBlocks(WorldPositions, DirtyChunks);
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	for (AGreedyChunk* DirtyChunk : DirtyChunks)
+	{
+		DirtyChunk->LastEditTime = Now;
+
+		// Small edits show up this frame, chunks that only had their light changed or were just created remesh
+		const TArray<FIntVector>* ChunkChanged = Changed.Find(DirtyChunk);
+
+		if (!ChunkChanged || !DirtyChunk->PatchMesh(*ChunkChanged))
+		{
+			DirtyChunk->GenerateMesh();
+		}
+	}
+}
+
+void AChunkWorld::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bMergeRegions)
+	{
+		UpdateRegions();
+	}
+
+	if (CollisionRadius > 0)
+	{
+		UpdateCollisionRings();
+	}
+
+	TOptional<FVector> ViewLocation;
+
+	// Culling is shared by every view of the world, with split-screen players there is no single view to cull for
+	const UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	const bool bSingleView = !GameInstance || GameInstance->GetNumLocalPlayers() <= 1;
+
+	if (const APlayerController* PlayerController = bSingleView ? GetWorld()->GetFirstPlayerController() : nullptr)
+	{
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation.Emplace(), ViewRotation);
+	}
+
+	TSet<AGreedyChunk*> VisibleChunks;
+	const bool bOcclusionCulling = ViewLocation.IsSet() && GChunkOcclusionCulling;
+
+	if (bOcclusionCulling)
+	{
+		FindVisibleChunks(ViewLocation.GetValue(), VisibleChunks);
+	}
+
+	if (!GFaceDirectionCulling)
+	{
+		ViewLocation.Reset();
+	}
+
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		if (Pair.Value->IsInRegion())
+			continue;
+
+		const bool bVisible = !bOcclusionCulling || VisibleChunks.Contains(Pair.Value);
+		Pair.Value->SetChunkVisible(bVisible);
+
+		if (bVisible)
+		{
+			Pair.Value->UpdateFaceVisibility(ViewLocation);
+		}
+	}
+
+	// A region is drawn as soon as any of its chunks can be seen
+	for (TPair<FIntVector, FChunkRegion>& Pair : Regions)
+	{
+		FChunkRegion& Region = Pair.Value;
+
+		if (!Region.Component)
+			continue;
+
+		bool bVisible = !bOcclusionCulling;
+		for (int32 i = 0; i < Region.Parts.Num() && !bVisible; i++)
+		{
+			bVisible = Region.Parts[i].Revision != 0 && VisibleChunks.Contains(Region.Parts[i].Chunk);
+		}
+
+		if (Region.Component->IsVisible() != bVisible)
+		{
+			Region.Component->SetVisibility(bVisible);
+		}
+
+		// Region meshes sit at the world origin
+		if (bVisible)
+		{
+			AGreedyChunk::UpdateSectionVisibility(Region.Component->GetRealtimeMeshAs<URealtimeMeshSimple>(),
+			                                      Region.FaceBounds, ViewLocation, Region.VisibleFaces);
+		}
+	}
+}
+
+void AChunkWorld::UpdateCollisionRings()
+{
+	struct FRingSource
+	{
+		FVector Location;
+
+		// Reach of the source itself, chunks up to CollisionRadius beyond it collide
+		double Radius;
+	};
+
+	TArray<FRingSource, TInlineAllocator<8>> Sources;
+
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		// Bodies simulating physics would fall through chunks without collision just like pawns
+		const UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(It->GetRootComponent());
+
+		if (Root && Root->IsSimulatingPhysics())
+		{
+			Sources.Add({Root->Bounds.Origin, Root->Bounds.SphereRadius});
+		}
+		else if (It->IsA<APawn>())
+		{
+			Sources.Add({It->GetActorLocation(), 0.0});
+		}
+	}
+
+	// Edit traces start at the view and need something to hit
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+			Sources.Add({ViewLocation, FMath::Max(EditReach - CollisionRadius, 0.0f)});
+		}
+	}
+
+	struct FCandidate
+	{
+		URealtimeMeshComponent* Component;
+		double Distance;
+	};
+
+	TArray<FCandidate> Candidates;
+
+	// Collision is dropped a little further out than it is added, so pawns on a border don't flip it every tick
+	const double AddRadius = CollisionRadius;
+	const double DropRadius = CollisionRadius * 1.25;
+
+	auto Visit = [&](URealtimeMeshComponent* Component, const FBox& Bounds)
+	{
+		double Distance = TNumericLimits<double>::Max();
+		for (const FRingSource& Source : Sources)
+		{
+			Distance = FMath::Min(Distance,
+			                      FMath::Sqrt(Bounds.ComputeSquaredDistanceToPoint(Source.Location)) - Source.Radius);
+		}
+
+		if (Component->IsCollisionEnabled())
+		{
+			if (Distance > DropRadius)
+			{
+				Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			}
+		}
+		else if (Distance <= AddRadius)
+		{
+			Candidates.Add({Component, Distance});
+		}
+	};
+
+	const FVector ChunkExtent = FVector(ChunkSize * VoxelSize);
+
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		if (!Pair.Value->IsInRegion())
+		{
+			const FVector Location = Pair.Value->GetActorLocation();
+			Visit(Pair.Value->GetMeshComponent(), FBox(Location, Location + ChunkExtent));
+		}
+	}
+
+	for (const TPair<FIntVector, FChunkRegion>& Pair : Regions)
+	{
+		FBox Bounds(ForceInit);
+		for (const FRegionPart& Part : Pair.Value.Parts)
+		{
+			if (Part.Revision != 0)
+			{
+				Bounds += FBox(Part.Chunk->GetActorLocation(), Part.Chunk->GetActorLocation() + ChunkExtent);
+			}
+		}
+
+		if (Bounds.IsValid)
+		{
+			Visit(Pair.Value.Component, Bounds);
+		}
+	}
+
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B)
+	{
+		return A.Distance < B.Distance;
+	});
+
+	for (int32 i = 0; i < FMath::Min(Candidates.Num(), MaxCollisionAddsPerTick); i++)
+	{
+		Candidates[i].Component->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	}
+}
+
+FIntVector AChunkWorld::GetRegionCoord(const FIntVector& Coord) const
+{
+	return FIntVector(FloorDiv(Coord.X, RegionSize), FloorDiv(Coord.Y, RegionSize), FloorDiv(Coord.Z, RegionSize));
+}
+
+bool AChunkWorld::IsSettled(const AGreedyChunk* Chunk) const
+{
+	return Chunk->LastEditTime + RegionSettleSeconds <= GetWorld()->GetTimeSeconds();
+}
+
+void AChunkWorld::OnChunkMeshed(AGreedyChunk* Chunk)
+{
+	// The region keeps drawing its current mesh until it takes the new one
+	if (IsSettled(Chunk))
+	{
+		QueueRegionUpdate(GetRegionCoord(Chunk->ChunkCoord));
+		return;
+	}
+
+	// Still being edited, it draws on its own until it settles
+	RemoveFromRegion(Chunk);
+	Chunk->LeaveRegion();
+}
+
+void AChunkWorld::UpdateRegions()
+{
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		if (!Pair.Value->IsInRegion() && Pair.Value->HasMesh() && IsSettled(Pair.Value))
+		{
+			QueueRegionUpdate(GetRegionCoord(Pair.Key));
+		}
+	}
+}
+
+void AChunkWorld::QueueRegionUpdate(const FIntVector& RegionCoord)
+{
+	FChunkRegion& Region = Regions.FindOrAdd(RegionCoord);
+	if (Region.bUpdateQueued)
+		return;
+
+	if (Region.Id == 0)
+	{
+		Region.Id = ++NumRegionIds;
+	}
+
+	Region.bUpdateQueued = true;
+
+	UMeshApplySubsystem::Enqueue(this, Region.Id, ++Region.UpdateRevision,
+	                             [WeakWorld = TWeakObjectPtr<AChunkWorld>(this), RegionCoord]()
+	                             {
+		                             if (AChunkWorld* World = WeakWorld.Get())
+		                             {
+			                             World->UpdateRegion(RegionCoord);
+		                             }
+	                             });
+}
+
+void AChunkWorld::UpdateRegion(const FIntVector& RegionCoord)
+{
+	// Cleared since it was queued
+	FChunkRegion* Region = Regions.Find(RegionCoord);
+	if (!Region)
+		return;
+
+	Region->bUpdateQueued = false;
+
+	TArray<AGreedyChunk*> Members;
+	const FIntVector First = RegionCoord * RegionSize;
+
+	for (int z = First.Z; z < First.Z + RegionSize; z++)
+	{
+		for (int y = First.Y; y < First.Y + RegionSize; y++)
+		{
+			for (int x = First.X; x < First.X + RegionSize; x++)
+			{
+				AGreedyChunk* Chunk = Chunks.FindRef(FIntVector(x, y, z));
+
+				// Edited again since the update was queued, it stays on its own
+				if (Chunk && Chunk->HasMesh() && IsSettled(Chunk))
+				{
+					Members.Add(Chunk);
+				}
+			}
+		}
+	}
+
+	if (!UpdateRegionInPlace(*Region, Members))
+	{
+		RebuildRegion(*Region, Members);
+	}
+
+	for (AGreedyChunk* Chunk : Members)
+	{
+		if (!Chunk->IsInRegion())
+		{
+			Chunk->JoinRegion();
+		}
+	}
+}
+
+bool AChunkWorld::UpdateRegionInPlace(FChunkRegion& Region, const TArray<AGreedyChunk*>& Members)
+{
+	URealtimeMeshSimple* RegionMesh = Region.Component
+		                                  ? Region.Component->GetRealtimeMeshAs<URealtimeMeshSimple>()
+		                                  : nullptr;
+	if (!RegionMesh)
+		return false;
+
+	TArray<FRegionPart*> Changed;
+
+	for (AGreedyChunk* Chunk : Members)
+	{
+		FRegionPart* Part = Region.Parts.FindByPredicate([Chunk](const FRegionPart& Existing)
+		{
+			return Existing.Chunk == Chunk;
+		});
+
+		// Joining for the first time, it has no ranges yet
+		if (!Part)
+			return false;
+
+		if (Part->Revision != Chunk->GetAppliedMeshRevision())
+		{
+			if (!AGreedyChunk::FitsMeshPart(Part->Layout, Chunk->GetMeshData()))
+				return false;
+
+			Changed.Add(Part);
+		}
+	}
+
+	bool bCollisionChanged = false;
+
+	for (FRegionPart& Part : Region.Parts)
+	{
+		if (Part.Revision != 0 && !Members.Contains(Part.Chunk))
+		{
+			AGreedyChunk::ReplaceMeshPart(RegionMesh, Part.Layout, {nullptr, FVector::ZeroVector});
+			Part.Revision = 0;
+			bCollisionChanged = true;
+		}
+	}
+
+	for (FRegionPart* Part : Changed)
+	{
+		const FChunkMeshData& Data = Part->Chunk->GetMeshData();
+		const FVector Offset = Part->Chunk->GetActorLocation();
+
+		AGreedyChunk::ReplaceMeshPart(RegionMesh, Part->Layout, {&Data, Offset});
+		Part->Revision = Part->Chunk->GetAppliedMeshRevision();
+
+		// Only ever grows, culling stays conservative
+		for (int32 Direction = 0; Direction < 6; ++Direction)
+		{
+			if (Data.DirectionBounds[Direction].IsValid)
+			{
+				Region.FaceBounds[Direction] += Data.DirectionBounds[Direction].ShiftBy(Offset);
+			}
+		}
+
+		bCollisionChanged = true;
+	}
+
+	if (bCollisionChanged)
+	{
+		BuildRegionCollision(Region);
+	}
+
+	return true;
+}
+
+void AChunkWorld::RebuildRegion(FChunkRegion& Region, const TArray<AGreedyChunk*>& Members)
+{
+	TArray<AGreedyChunk::FMeshPart> Parts;
+
+	for (AGreedyChunk* Chunk : Members)
+	{
+		Parts.Add({&Chunk->GetMeshData(), Chunk->GetActorLocation()});
+	}
+
+	if (!Region.Component)
+	{
+		Region.Component = NewObject<URealtimeMeshComponent>(this, NAME_None, RF_Transient);
+		Region.Component->SetMobility(EComponentMobility::Static);
+		Region.Component->SetCastShadow(true);
+		Region.Component->SetCollisionEnabled(CollisionRadius > 0
+			                                      ? ECollisionEnabled::NoCollision
+			                                      : ECollisionEnabled::QueryAndPhysics);
+		Region.Component->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		Region.Component->RegisterComponent();
+		AddInstanceComponent(Region.Component);
+	}
+
+	TArray<AGreedyChunk::FMeshPartLayout> Layouts;
+	Region.VisibleFaces = AGreedyChunk::BuildMesh(Region.Component->InitializeRealtimeMesh<URealtimeMeshSimple>(),
+	                                              Parts, Material, Region.FaceBounds, GRegionSlack, &Layouts);
+
+	Region.Parts.Reset(Members.Num());
+
+	for (int32 i = 0; i < Members.Num(); i++)
+	{
+		Region.Parts.Add({Members[i], Layouts[i], Members[i]->GetAppliedMeshRevision()});
+	}
+}
+
+void AChunkWorld::BuildRegionCollision(FChunkRegion& Region)
+{
+	TArray<AGreedyChunk::FMeshPart> Parts;
+
+	for (const FRegionPart& Part : Region.Parts)
+	{
+		if (Part.Revision != 0)
+		{
+			Parts.Add({&Part.Chunk->GetMeshData(), Part.Chunk->GetActorLocation()});
+		}
+	}
+
+	AGreedyChunk::BuildCollision(Region.Component->GetRealtimeMeshAs<URealtimeMeshSimple>(), Parts);
+}
+
+void AChunkWorld::RemoveFromRegion(AGreedyChunk* Chunk)
+{
+	if (!Chunk->IsInRegion())
+		return;
+
+	FChunkRegion* Region = Regions.Find(GetRegionCoord(Chunk->ChunkCoord));
+	if (!Region || !Region->Component)
+		return;
+
+	for (FRegionPart& Part : Region->Parts)
+	{
+		if (Part.Chunk == Chunk && Part.Revision != 0)
+		{
+			// Only its index ranges are rewritten, the rest of the region stays as uploaded
+			AGreedyChunk::ReplaceMeshPart(Region->Component->GetRealtimeMeshAs<URealtimeMeshSimple>(), Part.Layout,
+			                              {nullptr, FVector::ZeroVector});
+			Part.Revision = 0;
+			BuildRegionCollision(*Region);
+		}
+	}
+}
+
+void AChunkWorld::FindVisibleChunks(const FVector& ViewLocation, TSet<AGreedyChunk*>& OutVisible) const
+{
+	struct FNode
+	{
+		FIntVector Coord;
+
+		// Face the walk came in through, INDEX_NONE for the view chunk
+		int32 EnteredFrom;
+
+		// Steps taken so far as EBlockDirection bits, the walk never turns back towards the view
+		uint8 Steps;
+	};
+
+	// Missing chunks that aren't solid are open air, as is a one chunk margin so views from outside still get in
+	const FIntVector SearchMin = ChunkMin - FIntVector(1);
+	const FIntVector SearchMax = ChunkMax + FIntVector(1);
+
+	const FVector ChunkExtent = FVector(ChunkSize * VoxelSize);
+	const FIntVector ViewChunk(
+		FMath::Clamp(FMath::FloorToInt(ViewLocation.X / ChunkExtent.X), SearchMin.X, SearchMax.X),
+		FMath::Clamp(FMath::FloorToInt(ViewLocation.Y / ChunkExtent.Y), SearchMin.Y, SearchMax.Y),
+		FMath::Clamp(FMath::FloorToInt(ViewLocation.Z / ChunkExtent.Z), SearchMin.Z, SearchMax.Z)
+	);
+
+	TArray<FNode> Queue;
+	TSet<FIntVector> Visited;
+
+	Queue.Add({ViewChunk, INDEX_NONE, 0});
+	Visited.Add(ViewChunk);
+
+	for (int32 Head = 0; Head < Queue.Num(); Head++)
+	{
+		const FNode Node = Queue[Head];
+
+		AGreedyChunk* const* Chunk = Chunks.Find(Node.Coord);
+		if (Chunk)
+		{
+			OutVisible.Add(*Chunk);
+		}
+		else if (Node.EnteredFrom != INDEX_NONE && SolidChunks.Contains(Node.Coord))
+		{
+			continue;
+		}
+
+		for (int32 Direction = 0; Direction < 6; Direction++)
+		{
+			if (Node.Steps >> OppositeDirection[Direction] & 1)
+				continue;
+
+			if (Chunk && Node.EnteredFrom != INDEX_NONE &&
+				!(*Chunk)->ConnectsFaces(static_cast<EBlockDirection>(Node.EnteredFrom),
+				                         static_cast<EBlockDirection>(Direction)))
+				continue;
+
+			const FIntVector Next = Node.Coord + ChunkSteps[Direction];
+
+			if (Next.X < SearchMin.X || Next.Y < SearchMin.Y || Next.Z < SearchMin.Z ||
+				Next.X > SearchMax.X || Next.Y > SearchMax.Y || Next.Z > SearchMax.Z)
+				continue;
+
+			bool bAlreadyVisited;
+			Visited.Add(Next, &bAlreadyVisited);
+			if (bAlreadyVisited)
+				continue;
+
+			Queue.Add({Next, OppositeDirection[Direction], static_cast<uint8>(Node.Steps | 1 << Direction)});
+		}
+	}
+}
+
+uint8 AChunkWorld::GetLight(const FIntVector& WorldVoxel) const
+{
+	EnsureLighting();
+	return Lighting ? Lighting->GetLight(WorldVoxel) : ChunkLight::MaxLevel << 4;
+}
+
+FVoxMemoryUsage AChunkWorld::LogMemoryReport(FVoxMemoryCounted& Counted) const
+{
+	EnsureLighting();
+
+	TArray<TPair<const AGreedyChunk*, FVoxMemoryUsage>> ChunkUsages;
+	ChunkUsages.Reserve(Chunks.Num());
+
+	for (const TPair<FIntVector, AGreedyChunk*>& Pair : Chunks)
+	{
+		ChunkUsages.Emplace(Pair.Value, Pair.Value->GetMemoryUsage(Counted));
+	}
+
+	ChunkUsages.Sort([](const TPair<const AGreedyChunk*, FVoxMemoryUsage>& A,
+	                    const TPair<const AGreedyChunk*, FVoxMemoryUsage>& B)
+	{
+		return A.Value.GetTotal() > B.Value.GetTotal();
+	});
+
+	FVoxMemoryUsage Total;
+
+	for (const TPair<const AGreedyChunk*, FVoxMemoryUsage>& ChunkUsage : ChunkUsages)
+	{
+		VoxMemory::LogUsage(FString::Printf(TEXT("Chunk %s"), *ChunkUsage.Key->ChunkCoord.ToString()), ChunkUsage.Value);
+		Total += ChunkUsage.Value;
+	}
+
+	// Merged meshes of the settled chunks, which keep only their mesh data
+	for (const TPair<FIntVector, FChunkRegion>& Pair : Regions)
+	{
+		FVoxMemoryUsage Usage;
+		if (Pair.Value.Component)
+		{
+			VoxMemory::AddMeshUsage(Pair.Value.Component->GetRealtimeMesh(), Usage, Counted);
+		}
+
+		VoxMemory::LogUsage(FString::Printf(TEXT("Region %s"), *Pair.Key.ToString()), Usage);
+		Total += Usage;
+	}
+
+	// Every first generation mesh of the session, only what no chunk shows anymore is new here
+	if (MeshDiskCache)
+	{
+		const SIZE_T DiskCacheBytes = MeshDiskCache->GetAllocatedSize(Counted.MeshData);
+		UE_LOG(LogTemp, Display, TEXT("Mesh disk cache entries: %.1f KB"), DiskCacheBytes / 1024.0);
+		Total.MeshCPU += DiskCacheBytes;
+	}
+
+	const SIZE_T BrightnessBytes = CachedBrightnessMap.GetAllocatedSize();
+	UE_LOG(LogTemp, Display, TEXT("Brightness map: %.1f KB"), BrightnessBytes / 1024.0);
+	Total.Voxels += BrightnessBytes;
+
+	VoxMemory::LogUsage(FString::Printf(TEXT("%s, %d chunks"), *GetName(), Chunks.Num()), Total);
+	return Total;
+}
+
+bool AChunkWorld::IsSolid(const FIntVector& WorldVoxel) const
+{
+	const FIntVector ChunkCoord = GetChunkCoord(WorldVoxel);
+
+	if (AGreedyChunk* const* Chunk = Chunks.Find(ChunkCoord))
+	{
+		const EBlock Block = (*Chunk)->GetBlock(WorldVoxel - ChunkCoord * ChunkSize);
+		return Block != EBlock::Air && Block != EBlock::Null;
+	}
+
+	return SolidChunks.Contains(ChunkCoord);
 }
 
 
 void AChunkWorld::PrecomputeBrightness(UTexture2D* Texture)
 {
+	LLM_SCOPE_BYTAG(Voxel_Brightness);
+
 	if (!Texture || !Texture->GetPlatformData())
 		return;
 
@@ -177,6 +1104,9 @@ void AChunkWorld::ShowHeightmap(UTexture2D* HeightmapTexture)
 
 void AChunkWorld::ClearChunks()
 {
+	// The light task reads the chunks and writes their light
+	EnsureLighting();
+
 	for (AActor* ChildActor : SpawnedChunks)
 	{
 		if (ChildActor)
@@ -186,5 +1116,24 @@ void AChunkWorld::ClearChunks()
 	}
 
 	CachedBrightnessMap.Empty();
+	for (const TPair<FIntVector, FChunkRegion>& Pair : Regions)
+	{
+		if (Pair.Value.Component)
+		{
+			Pair.Value.Component->DestroyComponent();
+		}
+	}
+
 	SpawnedChunks.Empty();
+	Chunks.Empty();
+	SolidChunks.Empty();
+	Regions.Empty();
+	Lighting.Reset();
+
+	if (MeshDiskCache)
+	{
+		MeshDiskCache->Save();
+		MeshDiskCache.Reset();
+	}
+	EditRevision = 0;
 }
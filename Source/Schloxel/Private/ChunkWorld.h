@@ -5,8 +5,17 @@
 #include "CoreMinimal.h"
 #include "Components/Widget.h"
 #include "GameFramework/Actor.h"
+#include "ChunkLighting.h"
+#include "GreedyChunk.h"
+#include "Async/Future.h"
+#include "Containers/StaticArray.h"
 #include "ChunkWorld.generated.h"
 
+class URealtimeMeshComponent;
+class FChunkMeshDiskCache;
+struct FVoxMemoryUsage;
+struct FVoxMemoryCounted;
+
 UCLASS()
 class AChunkWorld : public AActor
 {
@@ -17,12 +26,116 @@ public:
 
 	void ClearChunks();
 
+	// Applies the brush of AGreedyChunk::ModifyVoxel around a world voxel, across chunk borders. Elided chunks are
+	// created from their uniform block when the brush changes them, solid ones also when it digs up to them.
+	void ModifyVoxel(const FIntVector& WorldVoxel, EBlock Block);
+
+	// World voxel containing a world location
+	FIntVector GetVoxel(const FVector& Location) const;
+
+	uint8 GetLight(const FIntVector& WorldVoxel) const;
+
+	// Anything but air, elided solid chunks included. Voxels outside the spawned chunks are air.
+	bool IsSolid(const FIntVector& WorldVoxel) const;
+
+	// Chunks are placed in world space, voxel V covers [V * VoxelSize, (V + 1) * VoxelSize)
+	int GetVoxelSize() const { return VoxelSize; }
+
+	bool IsMergingRegions() const { return bMergeRegions; }
+
+	// A merging chunk has new mesh data, it goes to its region once it has settled
+	void OnChunkMeshed(AGreedyChunk* Chunk);
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	// Regions are merged in editor worlds too
+	virtual bool ShouldTickIfViewportsOnly() const override { return true; }
+
+	// Null unless bPersistMeshCache is set
+	const TSharedPtr<FChunkMeshDiskCache, ESPMode::ThreadSafe>& GetMeshDiskCache() const { return MeshDiskCache; }
+
+	// Counts edits since the chunks were spawned. Edits aren't saved, so only revision 0 meshes are persisted.
+	int32 GetEditRevision() const { return EditRevision; }
+
+	// Logs every chunk largest first, then the regions and the world's own data, see vox.MemReport
+	FVoxMemoryUsage LogMemoryReport(FVoxMemoryCounted& Counted) const;
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 	void SpawnChunks();
 
+	// Hands every chunk its mesh from the disk cache, false without touching them unless all of them are in it
+	bool ApplyCachedMeshes();
+
+	// Waits for the light of a warm start, before anything reads or changes it
+	void EnsureLighting() const;
+
+	// Spawns the chunk, it generates its blocks from the heightmap but isn't lit or meshed yet
+	AGreedyChunk* SpawnChunk(const FIntVector& Coord);
+
+	// Spawns an elided chunk after the world was lit and lights it, adds it and the chunks its light reached
+	AGreedyChunk* MaterializeChunk(const FIntVector& Coord, TSet<AGreedyChunk*>& OutDirtyChunks);
+
+	// Relights around the changed local positions and remeshes every chunk the light reached, plus DirtyChunks
+	void OnBlocksChanged(const TMap<AGreedyChunk*, TArray<FIntVector>>& Changed, TSet<AGreedyChunk*>& DirtyChunks);
+
+	FIntVector GetChunkCoord(const FIntVector& WorldVoxel) const;
+
+	// Chunks reachable from the view through open faces, walking away from the view only
+	void FindVisibleChunks(const FVector& ViewLocation, TSet<AGreedyChunk*>& OutVisible) const;
+
+	struct FRegionPart
+	{
+		AGreedyChunk* Chunk;
+		AGreedyChunk::FMeshPartLayout Layout;
+
+		// AGreedyChunk::GetAppliedMeshRevision of the mesh in its ranges, 0 once collapsed
+		uint32 Revision;
+	};
+
+	struct FChunkRegion
+	{
+		// Owned by this actor
+		URealtimeMeshComponent* Component = nullptr;
+
+		// Chunks the current region mesh was built from, including the ones collapsed since
+		TArray<FRegionPart> Parts;
+
+		TStaticArray<FBox, 6> FaceBounds = TStaticArray<FBox, 6>(InPlace, ForceInit);
+		uint8 VisibleFaces = 0;
+
+		// Key of its updates in UMeshApplySubsystem, assigned when the first one is queued
+		int32 Id = 0;
+		uint32 UpdateRevision = 0;
+		bool bUpdateQueued = false;
+	};
+
+	FIntVector GetRegionCoord(const FIntVector& Coord) const;
+	bool IsSettled(const AGreedyChunk* Chunk) const;
+
+	// Gives chunks and regions near pawns, physics bodies and the edit reach of the players collision and takes it
+	// away from the rest
+	void UpdateCollisionRings();
+
+	// Queues the regions of settled chunks that aren't in their region mesh yet
+	void UpdateRegions();
+
+	// UpdateRegion runs later through UMeshApplySubsystem, within its per-frame budget
+	void QueueRegionUpdate(const FIntVector& RegionCoord);
+
+	// Takes the settled chunks of the region into its mesh. Chunks with a new mesh are written into their own
+	// ranges, the whole region is only rebuilt when a mesh outgrows its ranges or a chunk joins for the first time.
+	void UpdateRegion(const FIntVector& RegionCoord);
+	bool UpdateRegionInPlace(FChunkRegion& Region, const TArray<AGreedyChunk*>& Members);
+	void RebuildRegion(FChunkRegion& Region, const TArray<AGreedyChunk*>& Members);
+	void BuildRegionCollision(FChunkRegion& Region);
+
+	// Collapses the chunk's ranges in its region mesh right away, the chunk draws itself from then on
+	void RemoveFromRegion(AGreedyChunk* Chunk);
+
 	UPROPERTY(EditAnywhere, Category="Chunk World")
 	int DrawDistance = 5;
 
@@ -32,6 +145,34 @@ private:
 	UPROPERTY(EditAnywhere, Category="Chunk World")
 	int VoxelSize = 100;
 
+	// Only chunks this close to a pawn or a simulating physics body collide, 0 lets every chunk collide
+	UPROPERTY(EditAnywhere, Category="Chunk World|Collision", meta=(ClampMin=0, Units="cm"))
+	float CollisionRadius = 0.0f;
+
+	// Chunks within this distance of a player's view also collide, so the edit traces of AMyPlayerController hit
+	UPROPERTY(EditAnywhere, Category="Chunk World|Collision", meta=(ClampMin=0, Units="cm"))
+	float EditReach = 10000.0f;
+
+	// Chunks gaining collision per tick, nearest first, so crossing into new ground doesn't hitch
+	UPROPERTY(EditAnywhere, Category="Chunk World|Collision", meta=(ClampMin=1))
+	int MaxCollisionAddsPerTick = 8;
+
+	// Draws settled chunks through one mesh per region, so draw calls scale with regions instead of chunks
+	UPROPERTY(EditAnywhere, Category="Chunk World|Regions")
+	bool bMergeRegions = false;
+
+	// Chunks per region along each axis
+	UPROPERTY(EditAnywhere, Category="Chunk World|Regions", meta=(EditCondition="bMergeRegions", ClampMin=1))
+	int RegionSize = 4;
+
+	// Edited chunks draw on their own until they have been left alone this long, then rejoin their region
+	UPROPERTY(EditAnywhere, Category="Chunk World|Regions", meta=(EditCondition="bMergeRegions", ClampMin=0))
+	float RegionSettleSeconds = 2.0f;
+
+	// Keeps finished chunk meshes in Saved/VoxelMeshCache, so launching with the same settings skips meshing
+	UPROPERTY(EditAnywhere, Category="Chunk World|Cache")
+	bool bPersistMeshCache = true;
+
 
 	UPROPERTY(EditInstanceOnly, Category="Chunk World")
 	TObjectPtr<UMaterialInterface> Material;
@@ -53,6 +194,30 @@ private:
 	UPROPERTY()
 	TArray<AActor*> SpawnedChunks;
 
+	// Kept alive by SpawnedChunks. Chunks that are all air or all stone are only spawned once an edit reaches them.
+	TMap<FIntVector, AGreedyChunk*> Chunks;
+
+	// Elided chunks below the terrain surface, they block visibility
+	TSet<FIntVector> SolidChunks;
+
+	TUniquePtr<FChunkLighting> Lighting;
+
+	// LightAll on the thread pool while the chunks show their cached meshes, see EnsureLighting
+	mutable TFuture<void> LightingTask;
+
+	TMap<FIntVector, FChunkRegion> Regions;
+	int32 NumRegionIds = 0;
+
+	TSharedPtr<FChunkMeshDiskCache, ESPMode::ThreadSafe> MeshDiskCache;
+	int32 EditRevision = 0;
+
+	// Everything that changes what the chunks generate, names the cache file
+	uint64 GetMeshCacheSettingsKey() const;
+
+	// Chunk coordinate range of Chunks
+	FIntVector ChunkMin = FIntVector::ZeroValue;
+	FIntVector ChunkMax = FIntVector::ZeroValue;
+
 #if WITH_EDITOR
 	UFUNCTION(CallInEditor, Category = "Chunk World")
 	void RegenerateChunks();
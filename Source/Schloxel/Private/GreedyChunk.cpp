@@ -1,12 +1,28 @@
 #include "GreedyChunk.h"
 #include "ChunkWorld.h"
+#include "ChunkLighting.h"
 #include "Enums.h"
 #include "MeshThread.h"
+#include "VoxMemory.h"
 #include "Engine/Texture2D.h"
 #include "PixelFormat.h"
 #include "Math/UnrealMathUtility.h"
 #include "RealtimeMeshComponent.h"
 #include "RealtimeMeshSimple.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
+
+static int32 GPatchMaxExtent = 16;
+static FAutoConsoleVariableRef CVarPatchMaxExtent(
+	TEXT("vox.PatchMaxExtent"),
+	GPatchMaxExtent,
+	TEXT("Edits spanning at most this many voxels on every axis patch the chunk mesh in place on the game thread. 0 always remeshes."));
+
+static float GPatchRemeshDelay = 0.5f;
+static FAutoConsoleVariableRef CVarPatchRemeshDelay(
+	TEXT("vox.PatchRemeshDelay"),
+	GPatchRemeshDelay,
+	TEXT("Seconds without further edits before a patched chunk is fully meshed again to merge its split quads."));
 
 // Sets default values
 AGreedyChunk::AGreedyChunk()
@@ -28,28 +44,40 @@ void AGreedyChunk::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
 
-	Blocks.SetNum(ChunkSize.X * ChunkSize.Y * ChunkSize.Z);
-
-	ClearMesh();
 	GenerateBlocks();
-	GenerateMesh();
+
+	// World chunks wait until their neighbours are generated and lit
+	if (!ChunkWorld)
+	{
+		GenerateMesh();
+	}
 }
 
 void AGreedyChunk::BeginPlay()
 {
 	Super::BeginPlay();
 
-	Blocks.SetNum(ChunkSize.X * ChunkSize.Y * ChunkSize.Z);
-
-	ClearMesh();
 	GenerateBlocks();
-	GenerateMesh();
+
+	// World chunks wait until their neighbours are generated and lit
+	if (!ChunkWorld)
+	{
+		GenerateMesh();
+	}
 }
 
 void AGreedyChunk::GenerateBlocks()
 {
+	LLM_SCOPE_BYTAG(Voxel_Blocks);
+
 	const auto Location = GetActorLocation();
 
+	// Only run length columns, the voxels are filled in once edits make a column too complex
+	Blocks.Reset();
+
+	TArray<uint16> Heights;
+	Heights.SetNum(ChunkSize.X * ChunkSize.Y);
+
 	for (int x = 0; x < ChunkSize.X; x++)
 	{
 		for (int y = 0; y < ChunkSize.Y; y++)
@@ -59,19 +87,34 @@ void AGreedyChunk::GenerateBlocks()
 
 			const float Height = GetPrecomputedPixelBrightness(Xpos, Ypos);
 
-			int32 HeightInt = FMath::Clamp(FMath::RoundToInt(Height), 0, ChunkSize.Z);
-
-			for (int z = 0; z < HeightInt; z++)
-			{
-				Blocks[GetBlockIndex(x, y, z)] = EBlock::Stone;
-			}
-
-			for (int z = HeightInt; z < ChunkSize.Z; z++)
-			{
-				Blocks[GetBlockIndex(x, y, z)] = EBlock::Air;
-			}
+			// Chunks stack vertically, each one holds its slice of the column
+			Heights[x + y * ChunkSize.X] = FMath::Clamp(FMath::RoundToInt(Height) - ChunkCoord.Z * ChunkSize.Z, 0,
+			                                            ChunkSize.Z);
 		}
 	}
+
+	Columns = FVoxColumns(ChunkSize, Heights, EBlock::Stone);
+}
+
+void AGreedyChunk::MaterializeBlocks()
+{
+	if (Columns.IsEmpty())
+		return;
+
+	Blocks = Columns.ToVolume();
+	Columns.Reset();
+}
+
+void AGreedyChunk::SetBlock(const FIntVector& Index, EBlock Block)
+{
+	// Edits clone shared bricks and grow columns
+	LLM_SCOPE_BYTAG(Voxel_Blocks);
+
+	if (!Columns.IsEmpty() && Columns.Set(Index.X, Index.Y, Index.Z, Block))
+		return;
+
+	MaterializeBlocks();
+	Blocks.Set(Index.X, Index.Y, Index.Z, Block);
 }
 
 float AGreedyChunk::GetPrecomputedPixelBrightness(int X, int Y) const
@@ -87,55 +130,421 @@ float AGreedyChunk::GetPrecomputedPixelBrightness(int X, int Y) const
 	return 0.0f;
 }
 
-void AGreedyChunk::ApplyMesh()
+void AGreedyChunk::ApplyMesh(const TSharedRef<const FChunkMeshData>& Data, uint32 Revision)
+{
+	// Jobs finish out of order, a patch or job from a newer snapshot may already be shown
+	if (Revision < AppliedMeshRevision)
+		return;
+
+	AppliedMeshRevision = Revision;
+	SetMesh(Data);
+}
+
+void AGreedyChunk::SetMesh(const TSharedRef<const FChunkMeshData>& Data)
+{
+	FaceConnections = Data->FaceConnections;
+
+	// Kept for patches and the region rebuilds, shared with the mesh caches
+	MeshData = Data;
+	bHasMesh = true;
+
+	if (ChunkWorld && ChunkWorld->IsMergingRegions())
+	{
+		// The world decides where it is drawn
+		ChunkWorld->OnChunkMeshed(this);
+		return;
+	}
+
+	BuildOwnMesh(*MeshData);
+}
+
+FVoxMemoryUsage AGreedyChunk::GetMemoryUsage(FVoxMemoryCounted& Counted) const
+{
+	FVoxMemoryUsage Usage;
+	Usage.Voxels = Blocks.GetAllocatedSize(Counted.Bricks) + Columns.GetAllocatedSize() + Light.GetAllocatedSize();
+
+	// Chunks with the same content share one mesh through the caches
+	bool bMeshDataCounted = false;
+	Counted.MeshData.Add(&MeshData.Get(), &bMeshDataCounted);
+
+	if (!bMeshDataCounted)
+	{
+		Usage.MeshCPU = MeshData->GetAllocatedSize() - MeshData->CollisionBoxes.GetAllocatedSize();
+		Usage.Collision = MeshData->CollisionBoxes.GetAllocatedSize();
+	}
+
+	VoxMemory::AddMeshUsage(Mesh->GetRealtimeMesh(), Usage, Counted);
+	return Usage;
+}
+
+bool AGreedyChunk::PatchMesh(const TArray<FIntVector>& Changed)
+{
+	if (!bHasMesh || Changed.IsEmpty() || GPatchMaxExtent <= 0)
+		return false;
+
+	FIntVector Min = Changed[0];
+	FIntVector Max = Changed[0];
+
+	for (const FIntVector& Position : Changed)
+	{
+		for (int Axis = 0; Axis < 3; ++Axis)
+		{
+			Min[Axis] = FMath::Min(Min[Axis], Position[Axis]);
+			Max[Axis] = FMath::Max(Max[Axis], Position[Axis]);
+		}
+	}
+
+	for (int Axis = 0; Axis < 3; ++Axis)
+	{
+		if (Max[Axis] - Min[Axis] + 1 > GPatchMaxExtent)
+			return false;
+
+		// Occlusion of the faces around the changed voxels reaches one cell further
+		Min[Axis] = FMath::Max(Min[Axis] - 1, 0);
+		Max[Axis] = FMath::Min(Max[Axis] + 1, ChunkSize[Axis] - 1);
+	}
+
+	AMeshThread Patcher(this, Min, Max);
+	FChunkMeshData Patched = Patcher.BuildPatch(*MeshData);
+
+	// Newest snapshot so far, jobs still running for older ones are dropped when they finish
+	ApplyMesh(MakeShared<const FChunkMeshData>(MoveTemp(Patched)), Patcher.GetRevision());
+
+	// Split quads and boxes, and light that changed outside the box, wait for the full mesh
+	if (GPatchRemeshDelay > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(RemeshTimer, this, &AGreedyChunk::GenerateMesh, GPatchRemeshDelay);
+	}
+	else
+	{
+		GenerateMesh();
+	}
+
+	return true;
+}
+
+void AGreedyChunk::BuildOwnMesh(const FChunkMeshData& Data)
+{
+	const FMeshPart Part{&Data, FVector::ZeroVector};
+	VisibleFaces = BuildMesh(Mesh->InitializeRealtimeMesh<URealtimeMeshSimple>(), MakeArrayView(&Part, 1), Material,
+	                         FaceBounds);
+}
+
+void AGreedyChunk::JoinRegion()
+{
+	bIsInRegion = true;
+	VisibleFaces = 0;
+	Mesh->SetRealtimeMesh(nullptr);
+}
+
+void AGreedyChunk::LeaveRegion()
+{
+	bIsInRegion = false;
+	BuildOwnMesh(*MeshData);
+}
+
+uint8 AGreedyChunk::BuildMesh(URealtimeMeshSimple* RealtimeMesh, TConstArrayView<FMeshPart> Parts,
+                              UMaterialInterface* Material, TStaticArray<FBox, 6>& OutFaceBounds, float Slack,
+                              TArray<FMeshPartLayout>* OutLayouts)
 {
-	AsyncTask(ENamedThreads::GameThread, [this]()
+	LLM_SCOPE_BYTAG(Voxel_MeshStreams);
+
+	RealtimeMesh::FRealtimeMeshStreamSet StreamSet;
+	RealtimeMesh::TRealtimeMeshBuilderLocal<uint32, FPackedNormal, FVector2DHalf, 1> Builder(StreamSet);
+
+	Builder.EnableTangents();
+	Builder.EnableTexCoords();
+	Builder.EnableColors();
+	Builder.EnablePolyGroups();
+
+	OutFaceBounds = TStaticArray<FBox, 6>(InPlace, ForceInit);
+
+	TArray<FMeshPartLayout> Layouts;
+	Layouts.SetNum(Parts.Num());
+
+	int32 NumVertices = 0;
+
+	for (int32 PartIndex = 0; PartIndex < Parts.Num(); ++PartIndex)
 	{
-		while (!MeshDataQueue.IsEmpty())
+		const FMeshPart& Part = Parts[PartIndex];
+		const FChunkMeshData& Data = *Part.Data;
+
+		for (int32 i = 0; i < Data.Vertices.Num(); ++i)
 		{
-			TQueue<FChunkMeshData>::FElementType data;
-			if (MeshDataQueue.Dequeue(data))
-			{
-				URealtimeMeshSimple* RealtimeMesh = Mesh->InitializeRealtimeMesh<URealtimeMeshSimple>();
+			Builder.AddVertex(FVector3f(Data.Vertices[i] + Part.Offset))
+			       .SetNormalAndTangent(FVector3f(Data.Normals[i]), FVector3f(0, 0, 0))
+			       .SetTexCoord(FVector2f(Data.UV0[i]))
+			       .SetColor(Data.Colors[i]);
+		}
 
-				RealtimeMesh::FRealtimeMeshStreamSet StreamSet;
-				RealtimeMesh::TRealtimeMeshBuilderLocal<uint16, FPackedNormal, FVector2DHalf, 1> Builder(StreamSet);
+		// Spare vertices sit on the part's corner, so they stay within its bounds
+		const int32 NumSpare = FMath::CeilToInt32(Data.Vertices.Num() * Slack);
 
-				Builder.EnableTangents();
-				Builder.EnableTexCoords();
-				Builder.EnableColors();
-				Builder.EnablePolyGroups();
+		for (int32 i = 0; i < NumSpare; ++i)
+		{
+			Builder.AddVertex(FVector3f(Part.Offset))
+			       .SetNormalAndTangent(FVector3f(0, 0, 1), FVector3f(0, 0, 0))
+			       .SetTexCoord(FVector2f::ZeroVector)
+			       .SetColor(FColor::Black);
+		}
 
-				for (int32 i = 0; i < data.Vertices.Num(); ++i)
-				{
-					int32 VertexIndex = Builder.AddVertex(FVector3f(data.Vertices[i]))
-					                           .SetNormalAndTangent(FVector3f(data.Normals[i]),
-					                                                FVector3f(0, 0, 0))
-					                           .SetTexCoord(FVector2f(data.UV0[i]));
-				}
+		Layouts[PartIndex].FirstVertex = NumVertices;
+		Layouts[PartIndex].NumVertices = Data.Vertices.Num() + NumSpare;
+		NumVertices += Layouts[PartIndex].NumVertices;
 
-				for (int32 i = 0; i < data.Triangles.Num(); i += 3)
+		for (int32 Direction = 0; Direction < 6; ++Direction)
+		{
+			if (Data.DirectionBounds[Direction].IsValid)
+			{
+				OutFaceBounds[Direction] += Data.DirectionBounds[Direction].ShiftBy(Part.Offset);
+			}
+		}
+	}
+
+	// Grouped by direction so every polygroup is one contiguous range
+	for (uint8 Direction = 0; Direction < 6; ++Direction)
+	{
+		for (int32 PartIndex = 0; PartIndex < Parts.Num(); ++PartIndex)
+		{
+			const FChunkMeshData& Data = *Parts[PartIndex].Data;
+			const int32 First = Layouts[PartIndex].FirstVertex;
+			const int32 FirstTriangle = Builder.NumTriangles();
+
+			for (int32 i = 0; i < Data.Triangles.Num(); i += 3)
+			{
+				if (Data.TriangleDirections[i / 3] == Direction)
 				{
-					Builder.AddTriangle(data.Triangles[i], data.Triangles[i + 1], data.Triangles[i + 2], 0);
+					Builder.AddTriangle(First + Data.Triangles[i], First + Data.Triangles[i + 1],
+					                    First + Data.Triangles[i + 2], Direction);
 				}
+			}
+
+			const int32 NumTriangles = Builder.NumTriangles() - FirstTriangle;
+			const int32 NumSpare = FMath::CeilToInt32(NumTriangles * Slack);
+
+			for (int32 i = 0; i < NumSpare; ++i)
+			{
+				Builder.AddTriangle(First, First, First, Direction);
+			}
+
+			Layouts[PartIndex].Triangles[Direction] = FIntPoint(FirstTriangle, NumTriangles + NumSpare);
+		}
+	}
+
+	if (OutLayouts)
+	{
+		*OutLayouts = MoveTemp(Layouts);
+	}
+
+	RealtimeMesh->SetupMaterialSlot(0, "PrimaryMaterial", Material);
+
+	const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(
+		0, FName("ChunkMesh"));
+
+	RealtimeMesh->CreateSectionGroup(GroupKey, StreamSet,
+	                                 FRealtimeMeshSectionGroupConfig(ERealtimeMeshSectionDrawType::Static));
+
+	uint8 Directions = 0;
+
+	for (int32 Direction = 0; Direction < 6; ++Direction)
+	{
+		if (!OutFaceBounds[Direction].IsValid)
+			continue;
+
+		const FRealtimeMeshSectionKey SectionKey = FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, Direction);
+		RealtimeMesh->UpdateSectionConfig(SectionKey, FRealtimeMeshSectionConfig(0), false);
+		Directions |= 1 << Direction;
+	}
+
+	BuildCollision(RealtimeMesh, Parts);
+	return Directions;
+}
+
+void AGreedyChunk::BuildCollision(URealtimeMeshSimple* RealtimeMesh, TConstArrayView<FMeshPart> Parts)
+{
+	LLM_SCOPE_BYTAG(Voxel_Collision);
+
+	// Boxes need no cooking, unlike the triangles
+	FRealtimeMeshSimpleGeometry SimpleGeometry;
+
+	for (const FMeshPart& Part : Parts)
+	{
+		for (const FBox& Box : Part.Data->CollisionBoxes)
+		{
+			FRealtimeMeshCollisionBox CollisionBox(Box.GetSize());
+			CollisionBox.Center = Box.GetCenter() + Part.Offset;
+			SimpleGeometry.Boxes.Add(CollisionBox);
+		}
+	}
+
+	FRealtimeMeshCollisionConfiguration CollisionConfig;
+	CollisionConfig.bUseComplexAsSimpleCollision = false;
+
+	RealtimeMesh->SetCollisionConfig(CollisionConfig);
+	RealtimeMesh->SetSimpleGeometry(SimpleGeometry);
+}
+
+bool AGreedyChunk::FitsMeshPart(const FMeshPartLayout& Layout, const FChunkMeshData& Data)
+{
+	if (Data.Vertices.Num() > Layout.NumVertices)
+		return false;
+
+	int32 NumTriangles[6] = {};
+	for (const uint8 Direction : Data.TriangleDirections)
+	{
+		++NumTriangles[Direction];
+	}
+
+	for (int32 Direction = 0; Direction < 6; ++Direction)
+	{
+		if (NumTriangles[Direction] > Layout.Triangles[Direction].Y)
+			return false;
+	}
+
+	return true;
+}
+
+bool AGreedyChunk::ReplaceMeshPart(URealtimeMeshSimple* RealtimeMesh, const FMeshPartLayout& Layout,
+                                   const FMeshPart& Part)
+{
+	const FChunkMeshData* Data = Part.Data;
+
+	if (Data && !FitsMeshPart(Layout, *Data))
+		return false;
+
+	LLM_SCOPE_BYTAG(Voxel_MeshStreams);
+
+	const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(0, FName("ChunkMesh"));
+
+	RealtimeMesh->EditMeshInPlace(GroupKey, [&Layout, &Part, Data](RealtimeMesh::FRealtimeMeshStreamSet& Streams)
+	{
+		using RealtimeMesh::FRealtimeMeshStreams;
+
+		RealtimeMesh::TRealtimeMeshBuilderLocal<uint32, FPackedNormal, FVector2DHalf, 1> Builder(Streams);
+		TSet<FRealtimeMeshStreamKey> Changed{FRealtimeMeshStreams::Triangles};
+
+		int32 NextTriangle[6];
+		for (int32 Direction = 0; Direction < 6; ++Direction)
+		{
+			NextTriangle[Direction] = Layout.Triangles[Direction].X;
+		}
+
+		const int32 First = Layout.FirstVertex;
+
+		if (Data)
+		{
+			for (int32 i = 0; i < Data->Vertices.Num(); ++i)
+			{
+				Builder.SetPosition(First + i, FVector3f(Data->Vertices[i] + Part.Offset));
+				Builder.EditVertex(First + i)
+				       .SetNormalAndTangent(FVector3f(Data->Normals[i]), FVector3f(0, 0, 0))
+				       .SetTexCoord(FVector2f(Data->UV0[i]))
+				       .SetColor(Data->Colors[i]);
+			}
+
+			for (int32 i = 0; i < Data->Triangles.Num(); i += 3)
+			{
+				Builder.SetTriangle(NextTriangle[Data->TriangleDirections[i / 3]]++, First + Data->Triangles[i],
+				                    First + Data->Triangles[i + 1], First + Data->Triangles[i + 2]);
+			}
 
-				RealtimeMesh->SetupMaterialSlot(0, "PrimaryMaterial", Material);
+			Changed.Append({
+				FRealtimeMeshStreams::Position, FRealtimeMeshStreams::Tangents, FRealtimeMeshStreams::TexCoords,
+				FRealtimeMeshStreams::Color
+			});
+		}
 
-				const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(
-					0, FName("ChunkMesh"));
-				const FRealtimeMeshSectionKey SectionKey = FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, 0);
+		// The rest of the ranges collapse onto one vertex and draw nothing
+		for (int32 Direction = 0; Direction < 6; ++Direction)
+		{
+			const int32 End = Layout.Triangles[Direction].X + Layout.Triangles[Direction].Y;
 
-				RealtimeMesh->CreateSectionGroup(GroupKey, StreamSet,
-				                                 FRealtimeMeshSectionGroupConfig(ERealtimeMeshSectionDrawType::Static));
-				RealtimeMesh->UpdateSectionConfig(SectionKey, FRealtimeMeshSectionConfig(0), true);
+			while (NextTriangle[Direction] < End)
+			{
+				Builder.SetTriangle(NextTriangle[Direction]++, First, First, First);
 			}
 		}
+
+		return Changed;
 	});
+
+	return true;
+}
+
+EBlockDirection AGreedyChunk::GetFaceDirection(const FVector& Normal)
+{
+	if (Normal.X != 0)
+		return Normal.X > 0 ? EBlockDirection::Forward : EBlockDirection::Back;
+
+	if (Normal.Y != 0)
+		return Normal.Y > 0 ? EBlockDirection::Right : EBlockDirection::Left;
+
+	return Normal.Z > 0 ? EBlockDirection::Up : EBlockDirection::Down;
+}
+
+void AGreedyChunk::SetChunkVisible(bool bVisible)
+{
+	if (Mesh->IsVisible() != bVisible)
+	{
+		Mesh->SetVisibility(bVisible);
+	}
+}
+
+void AGreedyChunk::UpdateFaceVisibility(const TOptional<FVector>& ViewLocation)
+{
+	TOptional<FVector> LocalView;
+	if (ViewLocation.IsSet())
+	{
+		LocalView = GetActorTransform().InverseTransformPosition(ViewLocation.GetValue());
+	}
+
+	UpdateSectionVisibility(Mesh->GetRealtimeMeshAs<URealtimeMeshSimple>(), FaceBounds, LocalView, VisibleFaces);
+}
+
+void AGreedyChunk::UpdateSectionVisibility(URealtimeMeshSimple* RealtimeMesh, const TStaticArray<FBox, 6>& Bounds,
+                                           const TOptional<FVector>& LocalView, uint8& InOutVisibleFaces)
+{
+	if (!RealtimeMesh)
+		return;
+
+	bool bInFront[6] = {true, true, true, true, true, true};
+
+	if (LocalView.IsSet())
+	{
+		const FVector& View = LocalView.GetValue();
+
+		// A direction is seen as long as the view is in front of its rearmost face plane
+		bInFront[0] = View.X > Bounds[0].Min.X;
+		bInFront[1] = View.Y > Bounds[1].Min.Y;
+		bInFront[2] = View.X < Bounds[2].Max.X;
+		bInFront[3] = View.Y < Bounds[3].Max.Y;
+		bInFront[4] = View.Z > Bounds[4].Min.Z;
+		bInFront[5] = View.Z < Bounds[5].Max.Z;
+	}
+
+	const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(0, FName("ChunkMesh"));
+
+	for (int32 Direction = 0; Direction < 6; ++Direction)
+	{
+		if (!Bounds[Direction].IsValid)
+			continue;
+
+		const bool bVisible = (InOutVisibleFaces >> Direction & 1) != 0;
+		if (bVisible == bInFront[Direction])
+			continue;
+
+		FRealtimeMeshSectionConfig Config(0);
+		Config.bIsMainPassRenderable = bInFront[Direction];
+
+		RealtimeMesh->UpdateSectionConfig(FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, Direction), Config,
+		                                  false);
+		InOutVisibleFaces ^= 1 << Direction;
+	}
 }
 
 void AGreedyChunk::GenerateMesh()
 {
-	MeshThread = new AMeshThread(this);
+	AMeshThread::Launch(this);
 }
 
 void AGreedyChunk::ModifyVoxel(const FIntVector Position, const EBlock Block)
@@ -144,7 +553,16 @@ void AGreedyChunk::ModifyVoxel(const FIntVector Position, const EBlock Block)
 		Position.Y < 0 || Position.Z < 0)
 		return;
 
-	constexpr int Radius = 8;
+	// The world relights and remeshes every chunk the change reaches, neighbours and elided chunks included
+	if (ChunkWorld)
+	{
+		ChunkWorld->ModifyVoxel(ChunkCoord * ChunkSize + Position, Block);
+		return;
+	}
+
+	constexpr int Radius = BrushRadius;
+
+	TArray<FIntVector> Changed;
 
 	for (int x = -Radius + 1; x <= Radius - 1; ++x)
 	{
@@ -152,18 +570,32 @@ void AGreedyChunk::ModifyVoxel(const FIntVector Position, const EBlock Block)
 		{
 			for (int z = -Radius + 1; z <= Radius - 1; ++z)
 			{
+				const FIntVector CurrentPos(Position.X + x, Position.Y + y, Position.Z + z);
+
+				if (CurrentPos.X >= ChunkSize.X || CurrentPos.Y >= ChunkSize.Y || CurrentPos.Z >= ChunkSize.Z ||
+					CurrentPos.X < 0 || CurrentPos.Y < 0 || CurrentPos.Z < 0)
+					continue;
+
 				float distance = FVector::Dist(FVector(x, y, z), FVector::ZeroVector);
 				if (distance <= Radius)
 				{
-					const int index = GetBlockIndex(Position.X + x, Position.Y + y, Position.Z + z);
-					if (index >= 0 && index < Blocks.Num())
-						Blocks[index] = Block;
+					if (GetBlock(CurrentPos) != Block)
+					{
+						SetBlock(CurrentPos, Block);
+						Changed.Add(CurrentPos);
+					}
 				}
 			}
 		}
 	}
 
-	GenerateMesh();
+	if (Changed.IsEmpty())
+		return;
+
+	if (!PatchMesh(Changed))
+	{
+		GenerateMesh();
+	}
 }
 
 int AGreedyChunk::GetBlockIndex(int X, int Y, int Z) const
@@ -173,18 +605,22 @@ int AGreedyChunk::GetBlockIndex(int X, int Y, int Z) const
 
 EBlock AGreedyChunk::GetBlock(FIntVector Index) const
 {
-	if (Index.X >= ChunkSize.X || Index.Y >= ChunkSize.Y || Index.Z >= ChunkSize.Z || Index.X < 0 || Index.Y < 0 ||
-		Index.Z < 0)
-		return EBlock::Air;
-	return Blocks[GetBlockIndex(Index.X, Index.Y, Index.Z)];
+	if (Columns.IsEmpty())
+		return Blocks.Get(Index.X, Index.Y, Index.Z);
+
+	return Columns.Get(Index.X, Index.Y, Index.Z);
 }
 
-bool AGreedyChunk::CompareMask(FMask M1, FMask M2) const
+uint8 AGreedyChunk::GetLight(FIntVector Index) const
 {
-	return M1.Block == M2.Block && M1.Normal == M2.Normal;
+	if (Index.X >= ChunkSize.X || Index.Y >= ChunkSize.Y || Index.Z >= ChunkSize.Z || Index.X < 0 || Index.Y < 0 ||
+		Index.Z < 0)
+		return ChunkWorld ? ChunkWorld->GetLight(ChunkCoord * ChunkSize + Index) : ChunkLight::MaxLevel << 4;
+
+	return Light.IsEmpty() ? ChunkLight::MaxLevel << 4 : Light.Get(Index);
 }
 
-void AGreedyChunk::ClearMesh()
+bool AGreedyChunk::CompareMask(FMask M1, FMask M2)
 {
-	MeshDataQueue.Empty();
+	return M1.Block == M2.Block && M1.Normal == M2.Normal && M1.AO == M2.AO && M1.Light == M2.Light;
 }
@@ -7,10 +7,17 @@
 #include "GameFramework/Actor.h"
 #include "ChunkMeshData.h"
 #include "Enums.h"
+#include "VoxBlockVolume.h"
+#include "VoxColumns.h"
+#include "VoxLightVolume.h"
 #include "RealtimeMeshComponent.h"
 #include "GreedyChunk.generated.h"
 
 class AMeshThread;
+class AChunkWorld;
+class URealtimeMeshSimple;
+struct FVoxMemoryUsage;
+struct FVoxMemoryCounted;
 class UProceduralMeshComponent;
 
 UCLASS()
@@ -23,14 +30,41 @@ public:
 	{
 		EBlock Block;
 		int Normal;
+
+		// 2 bit occlusion per quad corner, 3 is unoccluded. Faces only merge if all four match.
+		uint8 AO = 0xFF;
+
+		// Packed sky and block light of the air cell in front of the face
+		uint8 Light = 0;
+	};
+
+	// One chunk mesh placed at an offset, see BuildMesh
+	struct FMeshPart
+	{
+		const FChunkMeshData* Data;
+		FVector Offset;
+	};
+
+	// Where BuildMesh put a part, so ReplaceMeshPart can rewrite it without touching the others
+	struct FMeshPartLayout
+	{
+		int32 FirstVertex = 0;
+		int32 NumVertices = 0;
+
+		// First triangle and triangle count of the part in each EBlockDirection polygroup
+		TStaticArray<FIntPoint, 6> Triangles = TStaticArray<FIntPoint, 6>(InPlace, FIntPoint::ZeroValue);
 	};
 
 	AGreedyChunk();
 	void OnConstruction(const FTransform& Transform);
 
+	// Sets a sphere of voxels around a local position. World chunks hand it to AChunkWorld::ModifyVoxel, which
+	// carries it into the neighbours.
 	UFUNCTION(BlueprintCallable, Category="Chunk")
 	void ModifyVoxel(const FIntVector Position, const EBlock Block);
 
+	static constexpr int BrushRadius = 8;
+
 	UPROPERTY()
 	TObjectPtr<UMaterialInterface> Material;
 
@@ -40,15 +74,95 @@ public:
 
 	TMap<FIntPoint, int>* CachedBrightnessMap;
 
+	// Owning world, lights and meshes the chunk once all of its neighbours exist
+	AChunkWorld* ChunkWorld = nullptr;
+
+	FIntVector ChunkCoord = FIntVector::ZeroValue;
+
 	EBlock GetBlock(FIntVector Index) const;
 
-	bool CompareMask(FMask M1, FMask M2) const;
+	// Mesh jobs copy this, copies share bricks until the chunk is edited. Empty while the chunk is stored as columns.
+	const FVoxBlockVolume& GetBlocks() const { return Blocks; }
+
+	// Run length columns of terrain, kept through edits until a column gets too many runs. Empty once dense.
+	const FVoxColumns& GetColumns() const { return Columns; }
+
+	// Packed light, positions outside the chunk are looked up in the neighbours
+	uint8 GetLight(FIntVector Index) const;
+
+	static bool CompareMask(FMask M1, FMask M2);
+
+	// Forward is +X, Right +Y, Up +Z
+	static EBlockDirection GetFaceDirection(const FVector& Normal);
+
+	// True until the first mesh job reports otherwise
+	bool ConnectsFaces(EBlockDirection A, EBlockDirection B) const
+	{
+		return (FaceConnections >> (static_cast<int>(A) * 6 + static_cast<int>(B)) & 1) != 0;
+	}
+
+	// Shows or hides the whole chunk, cheap to call every frame
+	void SetChunkVisible(bool bVisible);
+
+	// Takes the direction sections that face away from the view out of the main pass, or draws all without one.
+	// They keep casting shadows, lights see the faces the camera doesn't. Game thread only.
+	void UpdateFaceVisibility(const TOptional<FVector>& ViewLocation);
+
+	// Same for any mesh built by BuildMesh, the view is in the mesh's local space
+	static void UpdateSectionVisibility(URealtimeMeshSimple* RealtimeMesh, const TStaticArray<FBox, 6>& Bounds,
+	                                    const TOptional<FVector>& LocalView, uint8& InOutVisibleFaces);
+
+	// One section group with a polygroup section per EBlockDirection. Returns the directions that have faces.
+	// Slack reserves that fraction of extra vertices and triangles per part and direction for ReplaceMeshPart,
+	// padded with degenerate triangles.
+	static uint8 BuildMesh(URealtimeMeshSimple* RealtimeMesh, TConstArrayView<FMeshPart> Parts,
+	                       UMaterialInterface* Material, TStaticArray<FBox, 6>& OutFaceBounds, float Slack = 0.0f,
+	                       TArray<FMeshPartLayout>* OutLayouts = nullptr);
+
+	static bool FitsMeshPart(const FMeshPartLayout& Layout, const FChunkMeshData& Data);
+
+	// Writes new data into the ranges of one part of a BuildMesh mesh, the triangles left over collapse. A part
+	// without data collapses entirely. False without touching the mesh if the data doesn't fit the ranges.
+	static bool ReplaceMeshPart(URealtimeMeshSimple* RealtimeMesh, const FMeshPartLayout& Layout, const FMeshPart& Part);
 
+	// Simple collision from the boxes of every part
+	static void BuildCollision(URealtimeMeshSimple* RealtimeMesh, TConstArrayView<FMeshPart> Parts);
 
-	void ApplyMesh();
+	URealtimeMeshComponent* GetMeshComponent() const { return Mesh; }
 
+	// Region chunks leave their own component empty and are drawn by AChunkWorld
+	bool IsInRegion() const { return bIsInRegion; }
+	void JoinRegion();
+
+	// Draws the kept mesh data on the chunk's own component again
+	void LeaveRegion();
+
+	// The mesh currently shown, small edits patch it in place
+	const FChunkMeshData& GetMeshData() const { return *MeshData; }
+	bool HasMesh() const { return bHasMesh; }
+
+	// Changes whenever GetMeshData does
+	uint32 GetAppliedMeshRevision() const { return AppliedMeshRevision; }
+
+	// Game time of the last edit that touched this chunk, its region waits for it to settle
+	double LastEditTime = TNumericLimits<double>::Lowest();
+
+
+	// Game thread only, called by UMeshApplySubsystem. Results older than the mesh already shown are dropped.
+	void ApplyMesh(const TSharedRef<const FChunkMeshData>& Data, uint32 Revision);
+
+	void GenerateMesh();
+
+	// Remeshes only around the changed voxels and shows the result this frame, then schedules a full mesh for
+	// once the edits stop (vox.PatchRemeshDelay). False if the edit is too large (vox.PatchMaxExtent).
+	bool PatchMesh(const TArray<FIntVector>& Changed);
+
+	// Taken by every snapshot, mesh jobs and patches alike, see ApplyMesh
+	uint32 NewMeshRevision() { return ++MeshRevision; }
+
+	// For vox.MemReport, the mesh and bricks are skipped if they were already counted
+	FVoxMemoryUsage GetMemoryUsage(FVoxMemoryCounted& Counted) const;
 
-	TQueue<FChunkMeshData> MeshDataQueue;
 
 	int VertexCount = 0;
 
@@ -59,22 +173,49 @@ private:
 	UPROPERTY()
 	TObjectPtr<URealtimeMeshComponent> Mesh;
 
-	TArray<EBlock> Blocks;
+	FVoxBlockVolume Blocks;
+	FVoxColumns Columns;
 
+	// Local face bounds of the current mesh per EBlockDirection
+	TStaticArray<FBox, 6> FaceBounds = TStaticArray<FBox, 6>(InPlace, ForceInit);
 
-	void GenerateBlocks();
+	// One bit per EBlockDirection section that is currently shown
+	uint8 VisibleFaces = 0;
 
-	float GetPrecomputedPixelBrightness(int X, int Y) const;
+	// See FChunkMeshData::FaceConnections
+	uint64 FaceConnections = ~0ull;
 
+	// Immutable, cache hits share it instead of copying
+	TSharedRef<const FChunkMeshData> MeshData = MakeShared<const FChunkMeshData>();
+	bool bHasMesh = false;
+	bool bIsInRegion = false;
 
-	void GenerateMesh();
+	// Last revision handed out and the one currently shown
+	uint32 MeshRevision = 0;
+	uint32 AppliedMeshRevision = 0;
 
+	FTimerHandle RemeshTimer;
 
-	int GetBlockIndex(int X, int Y, int Z) const;
+	void SetMesh(const TSharedRef<const FChunkMeshData>& Data);
+	void BuildOwnMesh(const FChunkMeshData& Data);
 
+	// Packed like ChunkLight, empty until the world lights the chunk
+	FVoxLightVolume Light;
 
-	void ClearMesh();
+	friend class FChunkLighting;
+	friend class AChunkWorld;
+
+
+	void GenerateBlocks();
 
+	// Fills Blocks from Columns
+	void MaterializeBlocks();
 
-	AMeshThread* MeshThread;
+	// Stays in the columns when it can, otherwise the whole chunk goes dense first
+	void SetBlock(const FIntVector& Index, EBlock Block);
+
+	float GetPrecomputedPixelBrightness(int X, int Y) const;
+
+
+	int GetBlockIndex(int X, int Y, int Z) const;
 };
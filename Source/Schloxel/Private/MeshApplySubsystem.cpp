@@ -0,0 +1,112 @@
+#include "MeshApplySubsystem.h"
+#include "VoxMemory.h"
+
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+
+static float GMeshApplyBudgetMs = 2.0f;
+static FAutoConsoleVariableRef CVarMeshApplyBudgetMs(
+	TEXT("vox.MeshApplyBudgetMs"),
+	GMeshApplyBudgetMs,
+	TEXT("Game thread milliseconds per frame spent building finished voxel meshes. At least one is applied per frame."));
+
+void UMeshApplySubsystem::Enqueue(const TWeakObjectPtr<AActor>& Owner, int32 Key, uint32 Revision,
+                                  TUniqueFunction<void()>&& Apply, SIZE_T Bytes)
+{
+	// Only hops over to find the owner's world, the mesh itself is built later within the budget
+	AsyncTask(ENamedThreads::GameThread, [Owner, Key, Revision, Apply = MoveTemp(Apply), Bytes]() mutable
+	{
+		LLM_SCOPE_BYTAG(Voxel_MeshData);
+
+		const AActor* Actor = Owner.Get();
+		UWorld* World = Actor ? Actor->GetWorld() : nullptr;
+
+		if (UMeshApplySubsystem* Subsystem = World ? World->GetSubsystem<UMeshApplySubsystem>() : nullptr)
+		{
+			Subsystem->Add({Owner, Key, Revision, MoveTemp(Apply), Bytes});
+		}
+	});
+}
+
+void UMeshApplySubsystem::Add(FPendingApply&& Item)
+{
+	for (FPendingApply& Existing : Pending)
+	{
+		if (Existing.Owner == Item.Owner && Existing.Key == Item.Key)
+		{
+			// Jobs finish out of order, the last one to finish isn't necessarily the newest
+			if (Item.Revision < Existing.Revision)
+				return;
+
+			Existing.Revision = Item.Revision;
+			Existing.Apply = MoveTemp(Item.Apply);
+			Existing.Bytes = Item.Bytes;
+			return;
+		}
+	}
+
+	Pending.Add(MoveTemp(Item));
+}
+
+void UMeshApplySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Pending.IsEmpty())
+		return;
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+
+	if (const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController())
+	{
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		// Stale owners sort to the front so they are dropped for free
+		Pending.StableSort([&ViewLocation](const FPendingApply& A, const FPendingApply& B)
+		{
+			const AActor* ActorA = A.Owner.Get();
+			const AActor* ActorB = B.Owner.Get();
+
+			if (!ActorA || !ActorB)
+				return !ActorA && ActorB;
+
+			return FVector::DistSquared(ActorA->GetActorLocation(), ViewLocation) <
+				FVector::DistSquared(ActorB->GetActorLocation(), ViewLocation);
+		});
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + GMeshApplyBudgetMs / 1000.0;
+
+	int32 NumDone = 0;
+	while (NumDone < Pending.Num())
+	{
+		FPendingApply& Item = Pending[NumDone++];
+		if (!Item.Owner.IsValid())
+			continue;
+
+		Item.Apply();
+
+		if (FPlatformTime::Seconds() >= EndTime)
+			break;
+	}
+
+	Pending.RemoveAt(0, NumDone, EAllowShrinking::No);
+}
+
+SIZE_T UMeshApplySubsystem::GetPendingBytes() const
+{
+	SIZE_T Bytes = 0;
+
+	for (const FPendingApply& Item : Pending)
+	{
+		Bytes += Item.Bytes;
+	}
+
+	return Bytes;
+}
+
+TStatId UMeshApplySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMeshApplySubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MeshApplySubsystem.generated.h"
+
+/**
+ * Applies finished mesh jobs on the game thread, nearest owners first, within a per-frame time budget
+ * (vox.MeshApplyBudgetMs). Owners are tracked weakly, results for destroyed actors are dropped.
+ */
+UCLASS()
+class UMeshApplySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Thread safe. A pending result of the same owner and key is replaced by one with the same or a higher
+	// Revision, taken when the job snapshotted its owner, and results older than the pending one are dropped.
+	// Bytes is what the result holds until it is applied, for vox.MemReport.
+	static void Enqueue(const TWeakObjectPtr<AActor>& Owner, int32 Key, uint32 Revision,
+	                    TUniqueFunction<void()>&& Apply, SIZE_T Bytes = 0);
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickableInEditor() const override { return true; }
+
+	int32 GetNumPending() const { return Pending.Num(); }
+	SIZE_T GetPendingBytes() const;
+
+private:
+	struct FPendingApply
+	{
+		TWeakObjectPtr<AActor> Owner;
+		int32 Key;
+		uint32 Revision;
+		TUniqueFunction<void()> Apply;
+		SIZE_T Bytes = 0;
+	};
+
+	void Add(FPendingApply&& Item);
+
+	TArray<FPendingApply> Pending;
+};
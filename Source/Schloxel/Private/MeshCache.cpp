@@ -0,0 +1,55 @@
+#include "MeshCache.h"
+
+#include "HAL/IConsoleManager.h"
+
+static bool GMeshCacheEnabled = true;
+static FAutoConsoleVariableRef CVarMeshCache(
+	TEXT("vox.MeshCache"),
+	GMeshCacheEnabled,
+	TEXT("Reuse finished chunk and model meshes for identical voxel content instead of meshing them again."));
+
+bool VoxMeshCache::IsEnabled()
+{
+	return GMeshCacheEnabled;
+}
+
+TMeshCache<FChunkMeshData>& VoxMeshCache::Chunks()
+{
+	static TMeshCache<FChunkMeshData> Cache(256);
+	return Cache;
+}
+
+TMeshCache<FVoxMeshData>& VoxMeshCache::Models()
+{
+	// Model meshes can be millions of vertices, only a few are kept
+	static TMeshCache<FVoxMeshData> Cache(8);
+	return Cache;
+}
+
+template <typename DataType>
+static void LogCacheStats(const TCHAR* Name, TMeshCache<DataType>& Cache)
+{
+	const int32 Hits = Cache.GetHits();
+	const int32 Lookups = Hits + Cache.GetMisses();
+
+	UE_LOG(LogTemp, Display, TEXT("%s mesh cache: %d hits, %d misses (%.1f%% hit rate), %d of %d entries"), Name, Hits,
+	       Cache.GetMisses(), Lookups > 0 ? 100.0f * Hits / Lookups : 0.0f, Cache.Num(), Cache.Max());
+}
+
+static FAutoConsoleCommand CmdMeshCacheStats(
+	TEXT("vox.MeshCacheStats"),
+	TEXT("Logs hits, misses and entries of the chunk and model mesh caches."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		LogCacheStats(TEXT("Chunk"), VoxMeshCache::Chunks());
+		LogCacheStats(TEXT("Model"), VoxMeshCache::Models());
+	}));
+
+static FAutoConsoleCommand CmdMeshCacheClear(
+	TEXT("vox.MeshCacheClear"),
+	TEXT("Drops every cached chunk and model mesh."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		VoxMeshCache::Chunks().Empty();
+		VoxMeshCache::Models().Empty();
+	}));
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "ChunkMeshData.h"
+#include "VoxMeshData.h"
+
+/**
+ * Finished meshes keyed by a hash of everything the mesher read, least recently used entries are dropped
+ * first. Thread safe, entries are immutable and shared with the actors showing them, nothing is copied in or out.
+ */
+template <typename DataType>
+class TMeshCache
+{
+public:
+	explicit TMeshCache(int32 MaxEntries) : Entries(MaxEntries)
+	{
+	}
+
+	TSharedPtr<const DataType> Find(uint64 Key)
+	{
+		FScopeLock Lock(&CacheLock);
+
+		if (const TSharedPtr<const DataType>* Found = Entries.FindAndTouch(Key))
+		{
+			Hits.Increment();
+			return *Found;
+		}
+
+		Misses.Increment();
+		return nullptr;
+	}
+
+	void Add(uint64 Key, const TSharedPtr<const DataType>& Data)
+	{
+		FScopeLock Lock(&CacheLock);
+		Entries.Add(Key, Data);
+	}
+
+	void Empty()
+	{
+		FScopeLock Lock(&CacheLock);
+		Entries.Empty(Entries.Max());
+	}
+
+	int32 Num()
+	{
+		FScopeLock Lock(&CacheLock);
+		return Entries.Num();
+	}
+
+	int32 Max()
+	{
+		FScopeLock Lock(&CacheLock);
+		return Entries.Max();
+	}
+
+	// Bytes of the entries not in CountedData yet, which are added to it
+	SIZE_T GetAllocatedSize(TSet<const void*>& CountedData)
+	{
+		FScopeLock Lock(&CacheLock);
+
+		SIZE_T Size = 0;
+		for (typename TLruCache<uint64, TSharedPtr<const DataType>>::TConstIterator It(Entries); It; ++It)
+		{
+			bool bAlreadyCounted = false;
+			CountedData.Add(It.Value().Get(), &bAlreadyCounted);
+
+			if (!bAlreadyCounted)
+			{
+				Size += It.Value()->GetAllocatedSize();
+			}
+		}
+		return Size;
+	}
+
+	int32 GetHits() const { return Hits.GetValue(); }
+	int32 GetMisses() const { return Misses.GetValue(); }
+
+private:
+	FCriticalSection CacheLock;
+	TLruCache<uint64, TSharedPtr<const DataType>> Entries;
+
+	FThreadSafeCounter Hits;
+	FThreadSafeCounter Misses;
+};
+
+namespace VoxMeshCache
+{
+	// vox.MeshCache
+	bool IsEnabled();
+
+	TMeshCache<FChunkMeshData>& Chunks();
+	TMeshCache<FVoxMeshData>& Models();
+}
@@ -0,0 +1,77 @@
+#include "MeshScratch.h"
+#include "HAL/IConsoleManager.h"
+
+static int32 GMeshScratchPoolSize = 8;
+static FAutoConsoleVariableRef CVarMeshScratchPoolSize(
+	TEXT("vox.MeshScratchPoolSize"),
+	GMeshScratchPoolSize,
+	TEXT("Mesh job scratches kept for reuse. Jobs beyond this many at once free theirs when they finish."));
+
+static int32 GMeshScratchMaxKB = 16 * 1024;
+static FAutoConsoleVariableRef CVarMeshScratchMaxKB(
+	TEXT("vox.MeshScratchMaxKB"),
+	GMeshScratchMaxKB,
+	TEXT("Scratches that grew beyond this many KB are freed when their job ends instead of going back to the pool."));
+
+namespace
+{
+	FCriticalSection PoolLock;
+	TArray<TUniquePtr<FMeshScratch>> Pool;
+}
+
+SIZE_T FMeshScratch::GetAllocatedSize() const
+{
+	SIZE_T Size = ChunkMask.GetAllocatedSize() + VoxMask.GetAllocatedSize() + Visited.GetAllocatedSize() +
+		CellQueue.GetAllocatedSize() + ColumnQueue.GetAllocatedSize() + ColumnsByHeight.GetAllocatedSize() +
+		Staging.GetAllocatedSize() + ChunkStaging.GetAllocatedSize();
+
+	for (const TArray<int32>& Columns : ColumnsByHeight)
+	{
+		Size += Columns.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+FMeshScratchScope::FMeshScratchScope()
+{
+	{
+		FScopeLock Lock(&PoolLock);
+		if (!Pool.IsEmpty())
+		{
+			Scratch = Pool.Pop(EAllowShrinking::No);
+		}
+	}
+
+	if (!Scratch)
+	{
+		Scratch = MakeUnique<FMeshScratch>();
+	}
+}
+
+FMeshScratchScope::~FMeshScratchScope()
+{
+	if (Scratch->GetAllocatedSize() <= static_cast<SIZE_T>(FMath::Max(GMeshScratchMaxKB, 0)) * 1024)
+	{
+		FScopeLock Lock(&PoolLock);
+		if (Pool.Num() < GMeshScratchPoolSize)
+		{
+			Pool.Add(MoveTemp(Scratch));
+		}
+	}
+
+	// Freed outside the lock
+	Scratch.Reset();
+}
+
+SIZE_T FMeshScratchScope::GetPooledBytes()
+{
+	FScopeLock Lock(&PoolLock);
+
+	SIZE_T Size = Pool.GetAllocatedSize();
+	for (const TUniquePtr<FMeshScratch>& Pooled : Pool)
+	{
+		Size += sizeof(FMeshScratch) + Pooled->GetAllocatedSize();
+	}
+	return Size;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GreedyChunk.h"
+#include "VoxMeshData.h"
+
+// One face of a vox model slice mask
+struct FVoxFaceMask
+{
+	uint8 Active : 1;
+	uint8 BlockType : 7;
+};
+
+/**
+ * Working memory of a mesh job. Scratches are pooled between jobs and only ever reset, so each one
+ * settles at the largest size it was asked for and meshing stops allocating once the pool is warm.
+ * The pool keeps at most vox.MeshScratchPoolSize of them, and none bigger than vox.MeshScratchMaxKB, so one
+ * huge slab doesn't stay resident for the rest of the session.
+ */
+struct FMeshScratch
+{
+	TArray<AGreedyChunk::FMask> ChunkMask;
+	TArray<FVoxFaceMask> VoxMask;
+
+	// Flood fill and box merging state
+	TBitArray<> Visited;
+	TArray<FIntVector> CellQueue;
+	TArray<int32> ColumnQueue;
+	TArray<TArray<int32>> ColumnsByHeight;
+
+	// Geometry of a vox model slab, copied out at its final size once the slab is done
+	FVoxMeshData Staging;
+
+	// Same for a chunk mesh, copied out once the chunk is done
+	FChunkMeshData ChunkStaging;
+
+	// Resizes without giving memory back
+	template <typename T>
+	static void Fill(TArray<T>& Buffer, int32 Num, const T& Value)
+	{
+		Buffer.Reset(Num);
+		Buffer.AddUninitialized(Num);
+		for (T& Element : Buffer)
+		{
+			Element = Value;
+		}
+	}
+
+	static void Fill(TBitArray<>& Bits, int32 Num, bool bValue)
+	{
+		Bits.Reset();
+		Bits.Add(bValue, Num);
+	}
+
+	SIZE_T GetAllocatedSize() const;
+};
+
+// Leases a scratch from the pool for as long as it lives. Jobs run on thread pool and ParallelFor workers,
+// a thread local scratch would keep the high water mark of every worker that ever meshed alive with no way
+// to trim it. A shared pool bounds how many are kept and how big they may be.
+class FMeshScratchScope
+{
+public:
+	FMeshScratchScope();
+	~FMeshScratchScope();
+
+	FMeshScratchScope(const FMeshScratchScope&) = delete;
+	FMeshScratchScope& operator=(const FMeshScratchScope&) = delete;
+
+	FMeshScratch& operator*() const { return *Scratch; }
+	FMeshScratch* operator->() const { return Scratch.Get(); }
+
+	// Bytes held by the idle scratches, for vox.MemReport
+	static SIZE_T GetPooledBytes();
+
+private:
+	TUniquePtr<FMeshScratch> Scratch;
+};
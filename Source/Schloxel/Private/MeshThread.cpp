@@ -2,12 +2,153 @@
 
 
 #include "MeshThread.h"
+#include "ChunkLighting.h"
+#include "ChunkMeshDiskCache.h"
+#include "ChunkWorld.h"
+#include "MeshApplySubsystem.h"
+#include "MeshCache.h"
+#include "MeshScratch.h"
+#include "VoxMemory.h"
+#include "Async/Async.h"
+#include "Hash/CityHash.h"
+
+namespace
+{
+	// Neighbour bits: 0 (-,-) 1 (0,-) 2 (+,-) 3 (-,0) 4 (+,0) 5 (-,+) 6 (0,+) 7 (+,+)
+	constexpr uint8 CornerAO(uint8 Neighbours, int Side1, int Side2, int Corner)
+	{
+		const int S1 = (Neighbours >> Side1) & 1;
+		const int S2 = (Neighbours >> Side2) & 1;
+		const int C = (Neighbours >> Corner) & 1;
+		return S1 && S2 ? 0 : 3 - (S1 + S2 + C);
+	}
+
+	// Every neighbourhood maps to the four packed corners at once, in V1..V4 order of CreateQuad
+	struct FAOTable
+	{
+		uint8 Values[256];
+
+		constexpr FAOTable() : Values()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				const uint8 N = static_cast<uint8>(i);
+				Values[i] = CornerAO(N, 3, 1, 0) | CornerAO(N, 4, 1, 2) << 2 | CornerAO(N, 3, 6, 5) << 4 |
+					CornerAO(N, 4, 6, 7) << 6;
+			}
+		}
+	};
+
+	constexpr FAOTable AOTable;
+
+	// Vertex color brightness per occlusion level
+	constexpr float AOBrightness[4] = {0.4f, 0.6f, 0.8f, 1.0f};
+
+	// Each light level is 80% of the one above, level 0 keeps a little ambient
+	struct FLightCurve
+	{
+		float Values[16];
+
+		constexpr FLightCurve() : Values()
+		{
+			float Value = 1.0f;
+			for (int i = 15; i >= 0; --i)
+			{
+				Values[i] = Value < 0.05f ? 0.05f : Value;
+				Value *= 0.8f;
+			}
+		}
+	};
+
+	constexpr FLightCurve LightCurve;
+}
 
 
 AMeshThread::AMeshThread(AGreedyChunk* greedyChunk)
 {
-	GreedyChunk = greedyChunk;
-	Thread = FRunnableThread::Create(this, TEXT("MeshThread"));
+	WeakChunk = greedyChunk;
+	Revision = greedyChunk->NewMeshRevision();
+
+	// Bricks are shared, edits made while the thread runs clone the ones they touch. Column chunks copy
+	// their runs, a few bytes per column.
+	Snapshot.Blocks = greedyChunk->GetBlocks();
+	Snapshot.Columns = greedyChunk->GetColumns();
+	Snapshot.bHeightfield = Snapshot.IsColumnar() && Snapshot.Columns.IsHeightfield();
+	Snapshot.Size = greedyChunk->ChunkSize;
+	Snapshot.VoxelSize = greedyChunk->VoxelSize;
+	Snapshot.Extent = Snapshot.Size;
+
+	bFirstGeneration = greedyChunk->ChunkWorld
+		                   ? greedyChunk->ChunkWorld->GetEditRevision() == 0
+		                   : !greedyChunk->HasMesh();
+
+	// Edits aren't saved, meshes of later revisions would never be asked for again
+	if (greedyChunk->ChunkWorld && greedyChunk->ChunkWorld->GetEditRevision() == 0)
+	{
+		DiskCache = greedyChunk->ChunkWorld->GetMeshDiskCache();
+		DiskKey = {greedyChunk->ChunkCoord, 0};
+	}
+
+	Snapshot.CopyLight(*greedyChunk);
+}
+
+AMeshThread::AMeshThread(AGreedyChunk* greedyChunk, const FIntVector& Min, const FIntVector& Max)
+{
+	WeakChunk = greedyChunk;
+	Revision = greedyChunk->NewMeshRevision();
+
+	Snapshot.Size = greedyChunk->ChunkSize;
+	Snapshot.VoxelSize = greedyChunk->VoxelSize;
+	Snapshot.Origin = Min - FIntVector(1);
+	Snapshot.Extent = Max - Min + FIntVector(3);
+
+	// A few hundred voxels copied dense, column chunks included, instead of sharing every brick of the chunk
+	TArray<EBlock> Blocks;
+	Blocks.Reserve(Snapshot.Extent.X * Snapshot.Extent.Y * Snapshot.Extent.Z);
+
+	for (int z = 0; z < Snapshot.Extent.Z; ++z)
+	{
+		for (int y = 0; y < Snapshot.Extent.Y; ++y)
+		{
+			for (int x = 0; x < Snapshot.Extent.X; ++x)
+			{
+				Blocks.Add(greedyChunk->GetBlock(Snapshot.Origin + FIntVector(x, y, z)));
+			}
+		}
+	}
+
+	Snapshot.Blocks = FVoxBlockVolume(Snapshot.Extent, Blocks);
+	Snapshot.CopyLight(*greedyChunk);
+}
+
+void FChunkSnapshot::CopyLight(const AGreedyChunk& Chunk)
+{
+	// Light is copied with its border, relighting keeps writing to the chunk and its neighbours
+	Light.SetNumUninitialized((Extent.X + 2) * (Extent.Y + 2) * (Extent.Z + 2));
+
+	int32 LightIndex = 0;
+	for (int z = Origin.Z - 1; z <= Origin.Z + Extent.Z; ++z)
+	{
+		for (int y = Origin.Y - 1; y <= Origin.Y + Extent.Y; ++y)
+		{
+			for (int x = Origin.X - 1; x <= Origin.X + Extent.X; ++x)
+			{
+				Light[LightIndex++] = Chunk.GetLight(FIntVector(x, y, z));
+			}
+		}
+	}
+}
+
+void AMeshThread::Launch(AGreedyChunk* greedyChunk)
+{
+	Async(EAsyncExecution::ThreadPool, [Job = MakeUnique<AMeshThread>(greedyChunk)]()
+	{
+		if (Job->Init())
+		{
+			Job->Run();
+			Job->Exit();
+		}
+	});
 }
 
 bool AMeshThread::Init()
@@ -17,30 +158,109 @@ bool AMeshThread::Init()
 	return true;
 }
 
+uint64 FChunkSnapshot::GetContentHash() const
+{
+	uint64 Hash = IsColumnar() ? Columns.GetContentHash() : Blocks.GetContentHash();
+	Hash = CityHash128to64(Uint128_64(Hash, VoxelSize));
+
+	return CityHash64WithSeed(reinterpret_cast<const char*>(Light.GetData()), Light.Num(), Hash);
+}
+
 uint32 AMeshThread::Run()
+{
+	LLM_SCOPE_BYTAG(Voxel_MeshData);
+
+	// Meshes are local to the chunk, identical content meshes the same wherever it is. Edited content rarely
+	// comes back, so only first generations are hashed and kept.
+	const bool bUseCache = bFirstGeneration && VoxMeshCache::IsEnabled();
+	const uint64 CacheKey = bUseCache ? Snapshot.GetContentHash() : 0;
+
+	TSharedPtr<const FChunkMeshData> Cached = bUseCache ? VoxMeshCache::Chunks().Find(CacheKey) : nullptr;
+
+	if (!Cached && DiskCache)
+	{
+		Cached = DiskCache->Find(DiskKey);
+
+		if (Cached && bUseCache)
+		{
+			VoxMeshCache::Chunks().Add(CacheKey, Cached);
+		}
+	}
+
+	if (Cached)
+	{
+		Result = Cached;
+
+		// Keeps it in the file when it was found in memory first
+		if (DiskCache)
+		{
+			DiskCache->Add(DiskKey, Cached);
+		}
+		return 0;
+	}
+
+	FMeshScratchScope Lease;
+	Scratch = &*Lease;
+
+	ChunkMeshData = MoveTemp(Lease->ChunkStaging);
+	ChunkMeshData.Reset();
+
+	if (Snapshot.bHeightfield)
+	{
+		BuildColumnMesh();
+		ComputeHeightfieldConnections();
+		BuildHeightfieldCollision();
+	}
+	else if (Snapshot.IsColumnar())
+	{
+		// Edited columns may hold caves, connectivity and collision need the voxels
+		BuildColumnMesh();
+		ComputeFaceConnections();
+		BuildCollisionBoxes(FIntVector::ZeroValue, Snapshot.Size);
+	}
+	else
+	{
+		BuildVoxelMesh();
+		ComputeFaceConnections();
+		BuildCollisionBoxes(FIntVector::ZeroValue, Snapshot.Size);
+	}
+
+	Scratch = nullptr;
+
+	// Copied out at its final size, the chunk and the caches share the copy and the staging arrays go back warm
+	Result = MakeShared<const FChunkMeshData>(ChunkMeshData);
+	Lease->ChunkStaging = MoveTemp(ChunkMeshData);
+
+	if (bUseCache)
+	{
+		VoxMeshCache::Chunks().Add(CacheKey, Result);
+	}
+	if (DiskCache)
+	{
+		DiskCache->Add(DiskKey, Result);
+	}
+
+	return 0;
+}
+
+void AMeshThread::BuildVoxelMesh()
 {
 	for (int Axis = 0; Axis < 3; ++Axis)
 	{
 		const int Axis1 = (Axis + 1) % 3;
 		const int Axis2 = (Axis + 2) % 3;
 
-		const int MainAxisLimit = GreedyChunk->ChunkSize[Axis];
-		int Axis1Limit = GreedyChunk->ChunkSize[Axis1];
-		int Axis2Limit = GreedyChunk->ChunkSize[Axis2];
-
-		auto DeltaAxis1 = FIntVector::ZeroValue;
-		auto DeltaAxis2 = FIntVector::ZeroValue;
+		const int MainAxisLimit = Snapshot.Size[Axis];
+		int Axis1Limit = Snapshot.Size[Axis1];
+		int Axis2Limit = Snapshot.Size[Axis2];
 
 		auto ChunkItr = FIntVector::ZeroValue;
-		auto AxisMask = FIntVector::ZeroValue;
-
-		AxisMask[Axis] = 1;
 
-		TArray<AGreedyChunk::FMask> Mask;
-		Mask.SetNum(Axis1Limit * Axis2Limit);
+		TArray<AGreedyChunk::FMask>& Mask = Scratch->ChunkMask;
+		FMeshScratch::Fill(Mask, Axis1Limit * Axis2Limit, AGreedyChunk::FMask{EBlock::Null, 0});
 
 		//check each slice
-		for (ChunkItr[Axis] = -1; ChunkItr[Axis] < MainAxisLimit;)
+		for (ChunkItr[Axis] = -1; ChunkItr[Axis] < MainAxisLimit; ++ChunkItr[Axis])
 		{
 			int N = 0;
 
@@ -48,102 +268,414 @@ uint32 AMeshThread::Run()
 			{
 				for (ChunkItr[Axis1] = 0; ChunkItr[Axis1] < Axis1Limit; ++ChunkItr[Axis1])
 				{
-					const auto CurrentBlock = GreedyChunk->GetBlock(ChunkItr);
-					const auto CompareBlock = GreedyChunk->GetBlock(ChunkItr + AxisMask);
+					Mask[N++] = GetFaceMask(ChunkItr, Axis);
+				}
+			}
 
-					const bool CurrentBlockOpaque = CurrentBlock != EBlock::Air;
-					const bool CompareBlockOpaque = CompareBlock != EBlock::Air;
+			MergeSlice(Mask, Axis, ChunkItr[Axis] + 1, FIntPoint::ZeroValue, FIntPoint(Axis1Limit, Axis2Limit));
+		}
+	}
+}
 
-					if (CurrentBlockOpaque == CompareBlockOpaque)
-					{
-						Mask[N++] = AGreedyChunk::FMask{EBlock::Null, 0};
-					}
-					else if (CurrentBlockOpaque)
-					{
-						Mask[N++] = AGreedyChunk::FMask{CurrentBlock, 1};
-					}
-					else
+void AMeshThread::BuildColumnMesh()
+{
+	const FIntVector& Size = Snapshot.Size;
+
+	TArray<AGreedyChunk::FMask>& Mask = Scratch->ChunkMask;
+
+	// Top and bottom faces, Axis1 is X and Axis2 is Y. Every run boundary between air and solid is a face.
+	FMeshScratch::Fill(Mask, Size.X * Size.Y, AGreedyChunk::FMask{EBlock::Null, 0});
+
+	// Only the first Size.Z + 1 lists are used, longer ones are left over from taller chunks
+	TArray<TArray<int32>>& ColumnsByPlane = Scratch->ColumnsByHeight;
+	if (ColumnsByPlane.Num() < Size.Z + 1)
+	{
+		ColumnsByPlane.SetNum(Size.Z + 1);
+	}
+	for (int32 Plane = 0; Plane <= Size.Z; ++Plane)
+	{
+		ColumnsByPlane[Plane].Reset();
+	}
+
+	for (int32 Column = 0; Column < Size.X * Size.Y; ++Column)
+	{
+		const TConstArrayView<FVoxRun> Runs = Snapshot.Columns.GetColumn(Column % Size.X, Column / Size.X);
+
+		for (int32 Run = 0; Run < Runs.Num(); ++Run)
+		{
+			if (Runs[Run].Block == EBlock::Air)
+				continue;
+
+			// Outside the chunk counts as air, like everywhere else in the mesher
+			if (Run == 0 || Runs[Run - 1].Block == EBlock::Air)
+			{
+				ColumnsByPlane[Run == 0 ? 0 : Runs[Run - 1].End].Add(Column);
+			}
+			if (Run == Runs.Num() - 1 || Runs[Run + 1].Block == EBlock::Air)
+			{
+				ColumnsByPlane[Runs[Run].End].Add(Column);
+			}
+		}
+	}
+
+	for (int32 Plane = 0; Plane <= Size.Z; ++Plane)
+	{
+		if (ColumnsByPlane[Plane].IsEmpty())
+			continue;
+
+		FIntPoint Min(Size.X, Size.Y);
+		FIntPoint Max(0, 0);
+
+		for (const int32 Column : ColumnsByPlane[Plane])
+		{
+			const FIntPoint Cell(Column % Size.X, Column / Size.X);
+			Mask[Column] = GetFaceMask(FIntVector(Cell.X, Cell.Y, Plane - 1), 2);
+
+			Min = Min.ComponentMin(Cell);
+			Max = Max.ComponentMax(Cell + FIntPoint(1));
+		}
+
+		MergeSlice(Mask, 2, Plane, Min, Max);
+	}
+
+	// Walls between neighbouring columns only span the ranges where one of them is solid and the other is not
+	for (int Axis = 0; Axis < 2; ++Axis)
+	{
+		const int Axis1 = (Axis + 1) % 3;
+		const int Axis2 = (Axis + 2) % 3;
+		const int Axis1Limit = Size[Axis1];
+
+		FMeshScratch::Fill(Mask, Axis1Limit * Size[Axis2], AGreedyChunk::FMask{EBlock::Null, 0});
+
+		// The other horizontal axis, Y for X walls and X for Y walls
+		const int Across = Axis == 0 ? 1 : 0;
+
+		for (int Slice = -1; Slice < Size[Axis]; ++Slice)
+		{
+			FIntPoint Min(Size[Axis1], Size[Axis2]);
+			FIntPoint Max(0, 0);
+
+			for (int Row = 0; Row < Size[Across]; ++Row)
+			{
+				FIntVector Near = FIntVector::ZeroValue;
+				Near[Axis] = Slice;
+				Near[Across] = Row;
+
+				FIntVector Far = Near;
+				Far[Axis] += 1;
+
+				const TConstArrayView<FVoxRun> NearRuns = Snapshot.Columns.GetColumn(Near.X, Near.Y);
+				const TConstArrayView<FVoxRun> FarRuns = Snapshot.Columns.GetColumn(Far.X, Far.Y);
+
+				// Walks both run lists together, a missing column is air to the top
+				int32 NearRun = 0;
+				int32 FarRun = 0;
+
+				for (int32 Bottom = 0; Bottom < Size.Z;)
+				{
+					const bool bNearSolid = NearRun < NearRuns.Num() && NearRuns[NearRun].Block != EBlock::Air;
+					const bool bFarSolid = FarRun < FarRuns.Num() && FarRuns[FarRun].Block != EBlock::Air;
+
+					const int32 NearEnd = NearRun < NearRuns.Num() ? NearRuns[NearRun].End : Size.Z;
+					const int32 FarEnd = FarRun < FarRuns.Num() ? FarRuns[FarRun].End : Size.Z;
+					const int32 Top = FMath::Min(NearEnd, FarEnd);
+
+					if (bNearSolid != bFarSolid)
 					{
-						Mask[N++] = AGreedyChunk::FMask{CompareBlock, -1};
+						for (Near.Z = Bottom; Near.Z < Top; ++Near.Z)
+						{
+							const FIntPoint Cell(Near[Axis1], Near[Axis2]);
+							Mask[Cell.X + Cell.Y * Axis1Limit] = GetFaceMask(Near, Axis);
+
+							Min = Min.ComponentMin(Cell);
+							Max = Max.ComponentMax(Cell + FIntPoint(1));
+						}
 					}
+
+					NearRun += NearEnd == Top;
+					FarRun += FarEnd == Top;
+					Bottom = Top;
 				}
 			}
 
-			++ChunkItr[Axis];
-			N = 0;
+			if (Min.X < Max.X)
+			{
+				MergeSlice(Mask, Axis, Slice + 1, Min, Max);
+			}
+		}
+	}
+}
+
+FChunkMeshData AMeshThread::BuildPatch(const FChunkMeshData& Current)
+{
+	LLM_SCOPE_BYTAG(Voxel_MeshData);
+
+	// The snapshot holds the box and its border
+	const FIntVector Min = Snapshot.Origin + FIntVector(1);
+	const FIntVector Max = Snapshot.Origin + Snapshot.Extent - FIntVector(2);
+
+	FMeshScratchScope Lease;
+	Scratch = &*Lease;
+
+	ChunkMeshData = MoveTemp(Lease->ChunkStaging);
+	ChunkMeshData.Reset();
+	ChunkMeshData.FaceConnections = Current.FaceConnections;
+
+	const FBox Hole(FVector(Min) * Snapshot.VoxelSize, FVector(Max + FIntVector(1)) * Snapshot.VoxelSize);
+
+	for (const FBox& Box : Current.CollisionBoxes)
+	{
+		FBox Rest = Box;
+
+		// Slabs outside the box along each axis in turn, what is left in the middle is inside it
+		for (int Axis = 0; Axis < 3 && Rest.Min[Axis] < Rest.Max[Axis]; ++Axis)
+		{
+			if (Rest.Min[Axis] < Hole.Min[Axis])
+			{
+				FBox Piece = Rest;
+				Piece.Max[Axis] = FMath::Min(Rest.Max[Axis], Hole.Min[Axis]);
+				ChunkMeshData.CollisionBoxes.Add(Piece);
+				Rest.Min[Axis] = Hole.Min[Axis];
+			}
+
+			if (Rest.Max[Axis] > Hole.Max[Axis] && Rest.Min[Axis] < Rest.Max[Axis])
+			{
+				FBox Piece = Rest;
+				Piece.Min[Axis] = FMath::Max(Rest.Min[Axis], Hole.Max[Axis]);
+				ChunkMeshData.CollisionBoxes.Add(Piece);
+				Rest.Max[Axis] = Hole.Max[Axis];
+			}
+		}
+	}
+
+	// Every quad is 4 vertices in V1..V4 order of CreateQuad, V2 is along its width and V3 along its height
+	for (int32 First = 0; First + 3 < Current.Vertices.Num(); First += 4)
+	{
+		const FVector& Normal = Current.Normals[First];
+		const int Axis = FMath::Abs(Normal.X) > 0.5 ? 0 : FMath::Abs(Normal.Y) > 0.5 ? 1 : 2;
+		const int Axis1 = (Axis + 1) % 3;
+		const int Axis2 = (Axis + 2) % 3;
+
+		const FIntVector V1 = FIntVector(FMath::RoundToInt(Current.Vertices[First].X / Snapshot.VoxelSize),
+		                                 FMath::RoundToInt(Current.Vertices[First].Y / Snapshot.VoxelSize),
+		                                 FMath::RoundToInt(Current.Vertices[First].Z / Snapshot.VoxelSize));
+		const FIntPoint Size(
+			FMath::RoundToInt((Current.Vertices[First + 1][Axis1] - Current.Vertices[First][Axis1]) / Snapshot.VoxelSize),
+			FMath::RoundToInt((Current.Vertices[First + 2][Axis2] - Current.Vertices[First][Axis2]) / Snapshot.VoxelSize));
+
+		// The box in the quad's own cells
+		const FIntPoint Begin(FMath::Clamp(Min[Axis1] - V1[Axis1], 0, Size.X),
+		                      FMath::Clamp(Min[Axis2] - V1[Axis2], 0, Size.Y));
+		const FIntPoint End(FMath::Clamp(Max[Axis1] + 1 - V1[Axis1], 0, Size.X),
+		                    FMath::Clamp(Max[Axis2] + 1 - V1[Axis2], 0, Size.Y));
+
+		if (V1[Axis] < Min[Axis] || V1[Axis] > Max[Axis] + 1 || Begin.X == End.X || Begin.Y == End.Y)
+		{
+			CopyQuad(Current, First, Size, FIntPoint::ZeroValue, Size);
+			continue;
+		}
+
+		// Full width strips below and above the box, the rest of its rows left and right of it
+		if (Begin.Y > 0)
+			CopyQuad(Current, First, Size, FIntPoint(0, 0), FIntPoint(Size.X, Begin.Y));
+		if (End.Y < Size.Y)
+			CopyQuad(Current, First, Size, FIntPoint(0, End.Y), Size);
+		if (Begin.X > 0)
+			CopyQuad(Current, First, Size, FIntPoint(0, Begin.Y), FIntPoint(Begin.X, End.Y));
+		if (End.X < Size.X)
+			CopyQuad(Current, First, Size, FIntPoint(End.X, Begin.Y), FIntPoint(Size.X, End.Y));
+	}
 
-			// Generate mesh from the mask
-			for (int j = 0; j < Axis2Limit; ++j)
+	BuildCollisionBoxes(Min, Max + FIntVector(1));
+
+	TArray<AGreedyChunk::FMask>& Mask = Lease->ChunkMask;
+
+	for (int Axis = 0; Axis < 3; ++Axis)
+	{
+		const int Axis1 = (Axis + 1) % 3;
+		const int Axis2 = (Axis + 2) % 3;
+		const int Axis1Limit = Snapshot.Size[Axis1];
+
+		FMeshScratch::Fill(Mask, Axis1Limit * Snapshot.Size[Axis2], AGreedyChunk::FMask{EBlock::Null, 0});
+
+		const FIntPoint Begin(Min[Axis1], Min[Axis2]);
+		const FIntPoint End(Max[Axis1] + 1, Max[Axis2] + 1);
+
+		FIntVector Cell = FIntVector::ZeroValue;
+		for (int Plane = Min[Axis]; Plane <= Max[Axis] + 1; ++Plane)
+		{
+			Cell[Axis] = Plane - 1;
+
+			for (Cell[Axis2] = Begin.Y; Cell[Axis2] < End.Y; ++Cell[Axis2])
 			{
-				for (int i = 0; i < Axis1Limit;)
+				for (Cell[Axis1] = Begin.X; Cell[Axis1] < End.X; ++Cell[Axis1])
 				{
-					if (Mask[N].Normal != 0)
-					{
-						const auto CurrentMask = Mask[N];
-						ChunkItr[Axis1] = i;
-						ChunkItr[Axis2] = j;
+					Mask[Cell[Axis1] + Cell[Axis2] * Axis1Limit] = GetFaceMask(Cell, Axis);
+				}
+			}
 
-						int width;
+			MergeSlice(Mask, Axis, Plane, Begin, End);
+		}
+	}
 
-						for (width = 1; i + width < Axis1Limit && GreedyChunk->CompareMask(Mask[N + width], CurrentMask); ++width)
-						{
-						}
+	Scratch = nullptr;
 
-						int height;
-						bool done = false;
+	FChunkMeshData Patched = ChunkMeshData;
+	Lease->ChunkStaging = MoveTemp(ChunkMeshData);
+	return Patched;
+}
 
-						for (height = 1; j + height < Axis2Limit; ++height)
-						{
-							for (int k = 0; k < width; ++k)
-							{
-								if (GreedyChunk->CompareMask(Mask[N + k + height * Axis1Limit], CurrentMask)) continue;
+void AMeshThread::CopyQuad(const FChunkMeshData& From, int32 FirstVertex, const FIntPoint& Size,
+                           const FIntPoint& Begin, const FIntPoint& End)
+{
+	const FVector& Origin = From.Vertices[FirstVertex];
+	const FVector Step1 = (From.Vertices[FirstVertex + 1] - Origin) / Size.X;
+	const FVector Step2 = (From.Vertices[FirstVertex + 2] - Origin) / Size.Y;
 
-								done = true;
-								break;
-							}
+	const FVector2D& OriginUV = From.UV0[FirstVertex];
+	const FVector2D StepUV1 = (From.UV0[FirstVertex + 1] - OriginUV) / Size.X;
+	const FVector2D StepUV2 = (From.UV0[FirstVertex + 2] - OriginUV) / Size.Y;
 
-							if (done) break;
-						}
+	const FIntPoint Corners[4] = {Begin, FIntPoint(End.X, Begin.Y), FIntPoint(Begin.X, End.Y), End};
 
-						DeltaAxis1[Axis1] = width;
-						DeltaAxis2[Axis2] = height;
+	const uint8 Direction = From.TriangleDirections[FirstVertex / 2];
+	FBox& Bounds = ChunkMeshData.DirectionBounds[Direction];
 
+	for (int i = 0; i < 4; ++i)
+	{
+		const FVector Position = Origin + Step1 * Corners[i].X + Step2 * Corners[i].Y;
 
-						CreateQuad(CurrentMask, AxisMask, width, height,
-						           ChunkItr,
-						           ChunkItr + DeltaAxis1,
-						           ChunkItr + DeltaAxis2,
-						           ChunkItr + DeltaAxis1 + DeltaAxis2
-						);
+		ChunkMeshData.Vertices.Add(Position);
+		ChunkMeshData.Normals.Add(From.Normals[FirstVertex + i]);
+		ChunkMeshData.Colors.Add(From.Colors[FirstVertex + i]);
+		ChunkMeshData.UV0.Add(OriginUV + StepUV1 * Corners[i].X + StepUV2 * Corners[i].Y);
+		Bounds += Position;
+	}
 
+	// Same diagonal and winding, only moved to the new vertices
+	const int32 FirstIndex = FirstVertex / 4 * 6;
+	for (int i = 0; i < 6; ++i)
+	{
+		ChunkMeshData.Triangles.Add(From.Triangles[FirstIndex + i] - FirstVertex + ChunkMeshData.VertexCount);
+	}
 
-						DeltaAxis1 = FIntVector::ZeroValue;
-						DeltaAxis2 = FIntVector::ZeroValue;
+	ChunkMeshData.TriangleDirections.Append({Direction, Direction});
+	ChunkMeshData.VertexCount += 4;
+}
 
-						for (int l = 0; l < height; ++l)
-						{
-							for (int k = 0; k < width; ++k)
-							{
-								Mask[N + k + l * Axis1Limit] = AGreedyChunk::FMask{EBlock::Null, 0};
-							}
-						}
+AGreedyChunk::FMask AMeshThread::GetFaceMask(const FIntVector& Cell, int Axis) const
+{
+	const int Axis1 = (Axis + 1) % 3;
+	const int Axis2 = (Axis + 2) % 3;
+
+	FIntVector AxisMask = FIntVector::ZeroValue;
+	AxisMask[Axis] = 1;
+
+	EBlock CurrentBlock, CompareBlock;
+	Snapshot.GetBlockPair(Cell, Axis, CurrentBlock, CompareBlock);
+
+	const bool CurrentBlockOpaque = CurrentBlock != EBlock::Air;
+	const bool CompareBlockOpaque = CompareBlock != EBlock::Air;
+
+	if (CurrentBlockOpaque == CompareBlockOpaque)
+	{
+		return AGreedyChunk::FMask{EBlock::Null, 0};
+	}
+
+	if (CurrentBlockOpaque)
+	{
+		return AGreedyChunk::FMask{
+			CurrentBlock, 1, GetFaceAO(Cell + AxisMask, Axis1, Axis2), Snapshot.GetLight(Cell + AxisMask)
+		};
+	}
+
+	return AGreedyChunk::FMask{CompareBlock, -1, GetFaceAO(Cell, Axis1, Axis2), Snapshot.GetLight(Cell)};
+}
+
+void AMeshThread::MergeSlice(TArray<AGreedyChunk::FMask>& Mask, int Axis, int Plane, const FIntPoint& Begin,
+                             const FIntPoint& End)
+{
+	const int Axis1 = (Axis + 1) % 3;
+	const int Axis2 = (Axis + 2) % 3;
+	const int Axis1Limit = Snapshot.Size[Axis1];
+
+	auto DeltaAxis1 = FIntVector::ZeroValue;
+	auto DeltaAxis2 = FIntVector::ZeroValue;
+
+	auto ChunkItr = FIntVector::ZeroValue;
+	auto AxisMask = FIntVector::ZeroValue;
+
+	AxisMask[Axis] = 1;
+	ChunkItr[Axis] = Plane;
+
+	// Generate mesh from the mask
+	for (int j = Begin.Y; j < End.Y; ++j)
+	{
+		int N = Begin.X + j * Axis1Limit;
+
+		for (int i = Begin.X; i < End.X;)
+		{
+			if (Mask[N].Normal != 0)
+			{
+				const auto CurrentMask = Mask[N];
+				ChunkItr[Axis1] = i;
+				ChunkItr[Axis2] = j;
+
+				int width;
+
+				for (width = 1; i + width < End.X && AGreedyChunk::CompareMask(Mask[N + width], CurrentMask); ++width)
+				{
+				}
+
+				int height;
+				bool done = false;
+
+				for (height = 1; j + height < End.Y; ++height)
+				{
+					for (int k = 0; k < width; ++k)
+					{
+						if (AGreedyChunk::CompareMask(Mask[N + k + height * Axis1Limit], CurrentMask)) continue;
 
-						i += width;
-						N += width;
+						done = true;
+						break;
 					}
-					else
+
+					if (done) break;
+				}
+
+				DeltaAxis1[Axis1] = width;
+				DeltaAxis2[Axis2] = height;
+
+
+				CreateQuad(CurrentMask, AxisMask, width, height,
+				           ChunkItr,
+				           ChunkItr + DeltaAxis1,
+				           ChunkItr + DeltaAxis2,
+				           ChunkItr + DeltaAxis1 + DeltaAxis2
+				);
+
+
+				DeltaAxis1 = FIntVector::ZeroValue;
+				DeltaAxis2 = FIntVector::ZeroValue;
+
+				for (int l = 0; l < height; ++l)
+				{
+					for (int k = 0; k < width; ++k)
 					{
-						i++;
-						N++;
+						Mask[N + k + l * Axis1Limit] = AGreedyChunk::FMask{EBlock::Null, 0};
 					}
 				}
+
+				i += width;
+				N += width;
+			}
+			else
+			{
+				i++;
+				N++;
 			}
 		}
 	}
-
-	GreedyChunk->MeshDataQueue.Enqueue(ChunkMeshData);
-
-	return 0;
 }
 
 void AMeshThread::CreateQuad(AGreedyChunk::FMask Mask, FIntVector AxisMask, int Width, int Height, FIntVector V1, FIntVector V2, FIntVector V3, FIntVector V4)
@@ -152,20 +684,61 @@ void AMeshThread::CreateQuad(AGreedyChunk::FMask Mask, FIntVector AxisMask, int
 
 
 	ChunkMeshData.Vertices.Append({
-		FVector(V1) * GreedyChunk->VoxelSize,
-		FVector(V2) * GreedyChunk->VoxelSize,
-		FVector(V3) * GreedyChunk->VoxelSize,
-		FVector(V4) * GreedyChunk->VoxelSize
+		FVector(V1) * Snapshot.VoxelSize,
+		FVector(V2) * Snapshot.VoxelSize,
+		FVector(V3) * Snapshot.VoxelSize,
+		FVector(V4) * Snapshot.VoxelSize
 	});
 
-	ChunkMeshData.Triangles.Append({
-		ChunkMeshData.VertexCount,
-		ChunkMeshData.VertexCount + 2 + Mask.Normal,
-		ChunkMeshData.VertexCount + 2 - Mask.Normal,
-		ChunkMeshData.VertexCount + 3,
-		ChunkMeshData.VertexCount + 1 - Mask.Normal,
-		ChunkMeshData.VertexCount + 1 + Mask.Normal
-	});
+	const uint8 Direction = static_cast<uint8>(AGreedyChunk::GetFaceDirection(Normal));
+	ChunkMeshData.TriangleDirections.Append({Direction, Direction});
+
+	FBox& Bounds = ChunkMeshData.DirectionBounds[Direction];
+	for (int i = ChunkMeshData.Vertices.Num() - 4; i < ChunkMeshData.Vertices.Num(); ++i)
+	{
+		Bounds += ChunkMeshData.Vertices[i];
+	}
+
+	const uint8 AO[4] = {
+		static_cast<uint8>(Mask.AO & 3),
+		static_cast<uint8>(Mask.AO >> 2 & 3),
+		static_cast<uint8>(Mask.AO >> 4 & 3),
+		static_cast<uint8>(Mask.AO >> 6 & 3)
+	};
+
+	// Split along the brighter diagonal so occlusion doesn't bleed across the whole quad
+	if (AO[0] + AO[3] >= AO[1] + AO[2])
+	{
+		ChunkMeshData.Triangles.Append({
+			ChunkMeshData.VertexCount,
+			ChunkMeshData.VertexCount + 2 + Mask.Normal,
+			ChunkMeshData.VertexCount + 2 - Mask.Normal,
+			ChunkMeshData.VertexCount + 3,
+			ChunkMeshData.VertexCount + 1 - Mask.Normal,
+			ChunkMeshData.VertexCount + 1 + Mask.Normal
+		});
+	}
+	else
+	{
+		ChunkMeshData.Triangles.Append({
+			ChunkMeshData.VertexCount,
+			ChunkMeshData.VertexCount + (3 + Mask.Normal) / 2,
+			ChunkMeshData.VertexCount + (3 - Mask.Normal) / 2,
+			ChunkMeshData.VertexCount + 1,
+			ChunkMeshData.VertexCount + (5 - Mask.Normal) / 2,
+			ChunkMeshData.VertexCount + (5 + Mask.Normal) / 2
+		});
+	}
+
+	// Brightest of sky and block light scaled by AO, alpha keeps the sky share so materials can dim it at night
+	const uint8 Sky = ChunkLight::GetSky(Mask.Light);
+	const float Light = LightCurve.Values[FMath::Max(Sky, ChunkLight::GetBlock(Mask.Light))];
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const uint8 Brightness = static_cast<uint8>(FMath::RoundToInt(255.0f * Light * AOBrightness[AO[i]]));
+		ChunkMeshData.Colors.Add(FColor(Brightness, Brightness, Brightness, Sky * 17));
+	}
 
 	ChunkMeshData.Normals.Append({
 		Normal,
@@ -197,8 +770,340 @@ void AMeshThread::CreateQuad(AGreedyChunk::FMask Mask, FIntVector AxisMask, int
 	ChunkMeshData.VertexCount += 4;
 }
 
+uint8 AMeshThread::GetFaceAO(const FIntVector& AirCell, int Axis1, int Axis2) const
+{
+	uint8 Neighbours = 0;
+	int Bit = 0;
+
+	for (int D2 = -1; D2 <= 1; ++D2)
+	{
+		for (int D1 = -1; D1 <= 1; ++D1)
+		{
+			if (D1 == 0 && D2 == 0)
+				continue;
+
+			FIntVector Offset = FIntVector::ZeroValue;
+			Offset[Axis1] = D1;
+			Offset[Axis2] = D2;
+
+			Neighbours |= (Snapshot.GetBlock(AirCell + Offset) != EBlock::Air) << Bit++;
+		}
+	}
+
+	return AOTable.Values[Neighbours];
+}
+
+void AMeshThread::ComputeFaceConnections()
+{
+	const FIntVector& Size = Snapshot.Size;
+	const int32 NumCells = Size.X * Size.Y * Size.Z;
+
+	// Solids start out visited, the fill only ever looks at the bits
+	TBitArray<>& Visited = Scratch->Visited;
+	MarkCells(Visited, FIntVector::ZeroValue, Size, true);
+	TArray<FIntVector>& Queue = Scratch->CellQueue;
+
+	ChunkMeshData.FaceConnections = 0;
+
+	for (int32 Cell = 0; Cell < NumCells; ++Cell)
+	{
+		if (Visited[Cell])
+			continue;
+
+		const FIntVector Start(Cell % Size.X, Cell / Size.X % Size.Y, Cell / (Size.X * Size.Y));
+
+		// Faces this pocket of air touches, as EBlockDirection bits
+		uint8 Faces = 0;
+
+		Visited[Cell] = true;
+		Queue.Reset();
+		Queue.Add(Start);
+
+		for (int32 Head = 0; Head < Queue.Num(); ++Head)
+		{
+			const FIntVector Position = Queue[Head];
+
+			Faces |= (Position.X == Size.X - 1) << static_cast<int>(EBlockDirection::Forward);
+			Faces |= (Position.Y == Size.Y - 1) << static_cast<int>(EBlockDirection::Right);
+			Faces |= (Position.X == 0) << static_cast<int>(EBlockDirection::Back);
+			Faces |= (Position.Y == 0) << static_cast<int>(EBlockDirection::Left);
+			Faces |= (Position.Z == Size.Z - 1) << static_cast<int>(EBlockDirection::Up);
+			Faces |= (Position.Z == 0) << static_cast<int>(EBlockDirection::Down);
+
+			for (int Axis = 0; Axis < 3; ++Axis)
+			{
+				for (int Step = -1; Step <= 1; Step += 2)
+				{
+					FIntVector Next = Position;
+					Next[Axis] += Step;
+
+					if (Next[Axis] < 0 || Next[Axis] >= Size[Axis])
+						continue;
+
+					const int32 NextCell = Next.X + Next.Y * Size.X + Next.Z * Size.X * Size.Y;
+					if (Visited[NextCell])
+						continue;
+
+					Visited[NextCell] = true;
+					Queue.Add(Next);
+				}
+			}
+		}
+
+		for (int A = 0; A < 6; ++A)
+		{
+			for (int B = 0; B < 6; ++B)
+			{
+				if ((Faces >> A & 1) && (Faces >> B & 1))
+				{
+					ChunkMeshData.FaceConnections |= 1ull << (A * 6 + B);
+				}
+			}
+		}
+	}
+}
+
+void AMeshThread::ComputeHeightfieldConnections()
+{
+	const FIntVector& Size = Snapshot.Size;
+	const int32 NumColumns = Size.X * Size.Y;
+
+	TBitArray<>& Visited = Scratch->Visited;
+	FMeshScratch::Fill(Visited, NumColumns, false);
+	TArray<int32>& Queue = Scratch->ColumnQueue;
+
+	ChunkMeshData.FaceConnections = 0;
+
+	// Air above neighbouring open columns always meets at the top, so each group of open columns is one pocket
+	for (int32 Start = 0; Start < NumColumns; ++Start)
+	{
+		if (Visited[Start] || Snapshot.GetHeight(Start % Size.X, Start / Size.X) >= Size.Z)
+			continue;
+
+		uint8 Faces = 1 << static_cast<int>(EBlockDirection::Up);
+
+		Visited[Start] = true;
+		Queue.Reset();
+		Queue.Add(Start);
+
+		for (int32 Head = 0; Head < Queue.Num(); ++Head)
+		{
+			const int32 Column = Queue[Head];
+			const int32 X = Column % Size.X;
+			const int32 Y = Column / Size.X;
+
+			Faces |= (X == Size.X - 1) << static_cast<int>(EBlockDirection::Forward);
+			Faces |= (Y == Size.Y - 1) << static_cast<int>(EBlockDirection::Right);
+			Faces |= (X == 0) << static_cast<int>(EBlockDirection::Back);
+			Faces |= (Y == 0) << static_cast<int>(EBlockDirection::Left);
+			Faces |= (Snapshot.GetHeight(X, Y) == 0) << static_cast<int>(EBlockDirection::Down);
+
+			const FIntPoint Neighbours[] = {{X + 1, Y}, {X - 1, Y}, {X, Y + 1}, {X, Y - 1}};
+			for (const FIntPoint& Next : Neighbours)
+			{
+				if (Next.X < 0 || Next.Y < 0 || Next.X >= Size.X || Next.Y >= Size.Y)
+					continue;
+
+				const int32 NextColumn = Next.X + Next.Y * Size.X;
+				if (Visited[NextColumn] || Snapshot.GetHeight(Next.X, Next.Y) >= Size.Z)
+					continue;
+
+				Visited[NextColumn] = true;
+				Queue.Add(NextColumn);
+			}
+		}
+
+		for (int A = 0; A < 6; ++A)
+		{
+			for (int B = 0; B < 6; ++B)
+			{
+				if ((Faces >> A & 1) && (Faces >> B & 1))
+				{
+					ChunkMeshData.FaceConnections |= 1ull << (A * 6 + B);
+				}
+			}
+		}
+	}
+}
+
+void AMeshThread::BuildCollisionBoxes(const FIntVector& Begin, const FIntVector& End)
+{
+	const FIntVector Size = End - Begin;
+
+	// Air starts out taken, so free means solid and not in a box yet
+	TBitArray<>& Taken = Scratch->Visited;
+	MarkCells(Taken, Begin, End, false);
+
+	auto IsFree = [&Taken, &Begin, &Size](int32 X, int32 Y, int32 Z)
+	{
+		return !Taken[X - Begin.X + (Y - Begin.Y) * Size.X + (Z - Begin.Z) * Size.X * Size.Y];
+	};
+
+	for (int32 z = Begin.Z; z < End.Z; ++z)
+	{
+		for (int32 y = Begin.Y; y < End.Y; ++y)
+		{
+			for (int32 x = Begin.X; x < End.X; ++x)
+			{
+				if (!IsFree(x, y, z))
+					continue;
+
+				// Grow along X, then whole rows along Y, then whole layers along Z
+				FIntVector BoxEnd(x + 1, y + 1, z + 1);
+
+				while (BoxEnd.X < End.X && IsFree(BoxEnd.X, y, z))
+				{
+					++BoxEnd.X;
+				}
+
+				for (bool bGrow = true; bGrow && BoxEnd.Y < End.Y;)
+				{
+					for (int32 i = x; i < BoxEnd.X && bGrow; ++i)
+					{
+						bGrow = IsFree(i, BoxEnd.Y, z);
+					}
+					BoxEnd.Y += bGrow;
+				}
+
+				for (bool bGrow = true; bGrow && BoxEnd.Z < End.Z;)
+				{
+					for (int32 j = y; j < BoxEnd.Y && bGrow; ++j)
+					{
+						for (int32 i = x; i < BoxEnd.X && bGrow; ++i)
+						{
+							bGrow = IsFree(i, j, BoxEnd.Z);
+						}
+					}
+					BoxEnd.Z += bGrow;
+				}
+
+				for (int32 k = z; k < BoxEnd.Z; ++k)
+				{
+					for (int32 j = y; j < BoxEnd.Y; ++j)
+					{
+						for (int32 i = x; i < BoxEnd.X; ++i)
+						{
+							Taken[i - Begin.X + (j - Begin.Y) * Size.X + (k - Begin.Z) * Size.X * Size.Y] = true;
+						}
+					}
+				}
+
+				ChunkMeshData.CollisionBoxes.Add(
+					FBox(FVector(x, y, z) * Snapshot.VoxelSize, FVector(BoxEnd) * Snapshot.VoxelSize));
+			}
+		}
+	}
+}
+
+void AMeshThread::MarkCells(TBitArray<>& Bits, const FIntVector& Begin, const FIntVector& End, bool bSolid) const
+{
+	const FIntVector Size = End - Begin;
+	const int32 SliceSize = Size.X * Size.Y;
+
+	FMeshScratch::Fill(Bits, SliceSize * Size.Z, false);
+
+	for (int32 y = Begin.Y; y < End.Y; ++y)
+	{
+		for (int32 x = Begin.X; x < End.X; ++x)
+		{
+			const int32 ColumnBit = x - Begin.X + (y - Begin.Y) * Size.X;
+
+			if (!Snapshot.IsColumnar())
+			{
+				for (int32 z = Begin.Z; z < End.Z; ++z)
+				{
+					if ((Snapshot.GetBlock(FIntVector(x, y, z)) != EBlock::Air) == bSolid)
+					{
+						Bits[ColumnBit + (z - Begin.Z) * SliceSize] = true;
+					}
+				}
+				continue;
+			}
+
+			int32 RunStart = 0;
+			for (const FVoxRun& Run : Snapshot.Columns.GetColumn(x, y))
+			{
+				const int32 From = FMath::Max<int32>(RunStart, Begin.Z);
+				const int32 To = FMath::Min<int32>(Run.End, End.Z);
+				RunStart = Run.End;
+
+				if ((Run.Block != EBlock::Air) != bSolid)
+					continue;
+
+				for (int32 z = From; z < To; ++z)
+				{
+					Bits[ColumnBit + (z - Begin.Z) * SliceSize] = true;
+				}
+			}
+		}
+	}
+}
+
+void AMeshThread::BuildHeightfieldCollision()
+{
+	const FIntVector& Size = Snapshot.Size;
+
+	TBitArray<>& Taken = Scratch->Visited;
+	FMeshScratch::Fill(Taken, Size.X * Size.Y, false);
+
+	for (int32 y = 0; y < Size.Y; ++y)
+	{
+		for (int32 x = 0; x < Size.X; ++x)
+		{
+			const int32 Height = Snapshot.GetHeight(x, y);
+			if (Taken[x + y * Size.X] || Height == 0)
+				continue;
+
+			auto IsSame = [this, &Taken, &Size, Height](int32 X, int32 Y)
+			{
+				return !Taken[X + Y * Size.X] && Snapshot.GetHeight(X, Y) == Height;
+			};
+
+			FIntPoint End(x + 1, y + 1);
+
+			while (End.X < Size.X && IsSame(End.X, y))
+			{
+				++End.X;
+			}
+
+			for (bool bGrow = true; bGrow && End.Y < Size.Y;)
+			{
+				for (int32 i = x; i < End.X && bGrow; ++i)
+				{
+					bGrow = IsSame(i, End.Y);
+				}
+				End.Y += bGrow;
+			}
+
+			for (int32 j = y; j < End.Y; ++j)
+			{
+				for (int32 i = x; i < End.X; ++i)
+				{
+					Taken[i + j * Size.X] = true;
+				}
+			}
+
+			ChunkMeshData.CollisionBoxes.Add(
+				FBox(FVector(x, y, 0) * Snapshot.VoxelSize, FVector(End.X, End.Y, Height) * Snapshot.VoxelSize));
+		}
+	}
+}
+
 void AMeshThread::Exit()
 {
-	GreedyChunk->ApplyMesh();
+	// Nothing reads the voxels anymore, later edits no longer have to clone the shared bricks
+	Snapshot = FChunkSnapshot();
+
+	const SIZE_T Bytes = Result->GetAllocatedSize();
+
+	UMeshApplySubsystem::Enqueue(WeakChunk, 0, Revision, [Owner = WeakChunk, Data = Result.ToSharedRef(),
+		                                            Revision = Revision]()
+	{
+		if (AGreedyChunk* Chunk = Owner.Get())
+		{
+			Chunk->ApplyMesh(Data, Revision);
+		}
+	}, Bytes);
+
 	FRunnable::Exit();
 }
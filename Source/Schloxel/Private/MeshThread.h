@@ -3,20 +3,97 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ChunkMeshDiskCache.h"
 #include "GreedyChunk.h"
+#include "VoxBlockVolume.h"
 #include "HAL/Runnable.h"
 
-class FRunnableThread;
 class AGreedyChunk;
+struct FMeshScratch;
+
+// Everything a mesh job reads, taken on the game thread so edits and relighting never race the worker
+struct FChunkSnapshot
+{
+	FVoxBlockVolume Blocks;
+
+	// Packed light of the same voxels with a one cell border from the neighbours, x -> y -> z
+	TArray<uint8> Light;
+
+	FIntVector Size = FIntVector::ZeroValue;
+	int VoxelSize = 0;
+
+	// Chunk position of the first voxel held and how many are held from there. The whole chunk unless the
+	// snapshot only serves a patch, column snapshots always hold the whole chunk.
+	FIntVector Origin = FIntVector::ZeroValue;
+	FIntVector Extent = FIntVector::ZeroValue;
+
+	// Run length columns of chunks that were never made dense
+	FVoxColumns Columns;
+
+	// Every column is solid below its height and air above
+	bool bHeightfield = false;
+
+	bool IsColumnar() const { return !Columns.IsEmpty(); }
+
+	// Zero outside the chunk, only meaningful for heightfields
+	int32 GetHeight(int32 X, int32 Y) const { return Columns.GetHeight(X, Y); }
+
+	EBlock GetBlock(const FIntVector& Index) const
+	{
+		if (!IsColumnar())
+			return Blocks.Get(Index.X - Origin.X, Index.Y - Origin.Y, Index.Z - Origin.Z);
+
+		return Columns.Get(Index.X, Index.Y, Index.Z);
+	}
+
+	// The block and the one after it along the axis
+	void GetBlockPair(const FIntVector& Index, int Axis, EBlock& OutBlock, EBlock& OutNext) const
+	{
+		if (!IsColumnar())
+		{
+			Blocks.GetWithNeighbour(Index.X - Origin.X, Index.Y - Origin.Y, Index.Z - Origin.Z, Axis, 1, OutBlock,
+			                        OutNext);
+			return;
+		}
+
+		FIntVector Next = Index;
+		Next[Axis] += 1;
+
+		OutBlock = GetBlock(Index);
+		OutNext = GetBlock(Next);
+	}
+
+	// Keys the mesh cache, covers everything the mesher reads including the light border from the neighbours
+	uint64 GetContentHash() const;
+
+	// Valid from Origin - 1 to Origin + Extent on every axis
+	uint8 GetLight(const FIntVector& Index) const
+	{
+		const FIntVector Local = Index - Origin + FIntVector(1);
+		return Light[(Local.Z * (Extent.Y + 2) + Local.Y) * (Extent.X + 2) + Local.X];
+	}
+
+	// Game thread, fills Light for Origin and Extent
+	void CopyLight(const AGreedyChunk& Chunk);
+};
 
 class AMeshThread : public FRunnable
 {
 public:
 	
-	AMeshThread(AGreedyChunk* greedyChunk);
+	// Snapshots the chunk, Launch runs the job
+	explicit AMeshThread(AGreedyChunk* greedyChunk);
+
+	// Snapshots only the voxels of [Min, Max] and a one voxel border around them for BuildPatch, which runs on
+	// the caller's thread
+	AMeshThread(AGreedyChunk* greedyChunk, const FIntVector& Min, const FIntVector& Max);
 
-	AGreedyChunk* GreedyChunk;
-	FRunnableThread* Thread;
+	// Meshes the chunk on a pool thread. The task owns the job and frees it with its snapshot once the result is
+	// queued, so the bricks it pinned are released before the mesh is applied.
+	static void Launch(AGreedyChunk* greedyChunk);
+
+	// The chunk is never touched from the worker, the result is only handed back if it still exists
+	TWeakObjectPtr<AGreedyChunk> WeakChunk;
 
 	virtual bool Init() override;
 	virtual uint32 Run() override;
@@ -24,6 +101,66 @@ public:
 
 	void CreateQuad(AGreedyChunk::FMask Mask, FIntVector AxisMask, int Width, int Height, FIntVector V1, FIntVector V2, FIntVector V3, FIntVector V4);
 
+	// Corner occlusion of the face seen from the air cell, sampled from its 8 neighbours in the face plane
+	uint8 GetFaceAO(const FIntVector& AirCell, int Axis1, int Axis2) const;
+
+	// Flood fills the air of the chunk and records which of its six faces see each other
+	void ComputeFaceConnections();
+
+	// Same from the column heights alone
+	void ComputeHeightfieldConnections();
+
+	// Game thread. The current mesh with its faces on the planes of the patch box replaced by freshly merged ones,
+	// quads reaching out of the box are split around it. Collision boxes are cut around the box the same way and
+	// the solids inside merged anew, connectivity is kept from Current.
+	FChunkMeshData BuildPatch(const FChunkMeshData& Current);
+
+	uint32 GetRevision() const { return Revision; }
+
+	// Greedily merges the solid voxels of [Begin, End) into as few boxes as it can
+	void BuildCollisionBoxes(const FIntVector& Begin, const FIntVector& End);
+
+	// One box per rectangle of columns with equal height
+	void BuildHeightfieldCollision();
+
 private:
+	// Three full sweeps over the voxels
+	void BuildVoxelMesh();
+
+	// Column chunks, work per run instead of per voxel. Horizontal faces come from run boundaries, walls
+	// only where the runs of neighbouring columns differ.
+	void BuildColumnMesh();
+
+	// Sets the bits of the solid (or air) voxels of [Begin, End), x -> y -> z from Begin. Column snapshots are
+	// walked run by run instead of searching the column for every voxel.
+	void MarkCells(TBitArray<>& Bits, const FIntVector& Begin, const FIntVector& End, bool bSolid) const;
+
+	// Face between the cell and its neighbour further along the axis, Null if there is none
+	AGreedyChunk::FMask GetFaceMask(const FIntVector& Cell, int Axis) const;
+
+	// Greedily merges the faces of one slice plane within [Begin, End) and clears them from the mask
+	void MergeSlice(TArray<AGreedyChunk::FMask>& Mask, int Axis, int Plane, const FIntPoint& Begin, const FIntPoint& End);
+
+	// The part [Begin, End) of a quad of From in cells along its width and height, corners keep their colors
+	void CopyQuad(const FChunkMeshData& From, int32 FirstVertex, const FIntPoint& Size, const FIntPoint& Begin,
+	              const FIntPoint& End);
+
+	FChunkSnapshot Snapshot;
 	FChunkMeshData ChunkMeshData;
+
+	// Handed to the chunk, shared with the caches
+	TSharedPtr<const FChunkMeshData> Result;
+
+	// Meshes of an unedited world or a chunk that has none yet, the only ones looked up in and added to the cache
+	bool bFirstGeneration = false;
+
+	// Leased from the pool for the duration of Run
+	FMeshScratch* Scratch = nullptr;
+
+	// Of the owning world, only set while the world is unedited
+	TSharedPtr<FChunkMeshDiskCache, ESPMode::ThreadSafe> DiskCache;
+	FChunkMeshCacheKey DiskKey;
+
+	// Taken from the chunk with the snapshot, see AGreedyChunk::ApplyMesh
+	uint32 Revision = 0;
 };
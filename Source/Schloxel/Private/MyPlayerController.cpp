@@ -2,6 +2,7 @@
 
 #include "MyPlayerController.h"
 
+#include "ChunkWorld.h"
 #include "GreedyChunk.h"
 #include "VoxelFunctionLibrary.h"
 #include "NiagaraFunctionLibrary.h"
@@ -55,6 +56,14 @@ void AMyPlayerController::OnRightMouseButtonPressed()
 			NiagaraSystemAsset = LoadObject<UNiagaraSystem>(nullptr, TEXT("/Game/FX/Niagara.Niagara"));
 		}
 
+		// Settled chunks are drawn and hit through the region meshes of their world
+		if (AChunkWorld* ChunkWorld = Cast<AChunkWorld>(HitResult.GetActor()))
+		{
+			ChunkWorld->ModifyVoxel(ChunkWorld->GetVoxel(HitResult.Location - HitResult.Normal), EBlock::Air);
+
+			NiagaraSystemAsset = LoadObject<UNiagaraSystem>(nullptr, TEXT("/Game/FX/Niagara.Niagara"));
+		}
+
 
 		if (AVoxModel* VoxModel = Cast<AVoxModel>(HitResult.GetActor()))
 		{
@@ -96,6 +105,11 @@ void AMyPlayerController::OnLeftMouseButtonPressed()
 				                                                 Chunk->ChunkSize), EBlock::Stone);
 		}
 
+		if (AChunkWorld* ChunkWorld = Cast<AChunkWorld>(HitResult.GetActor()))
+		{
+			ChunkWorld->ModifyVoxel(ChunkWorld->GetVoxel(HitResult.Location - HitResult.Normal), EBlock::Stone);
+		}
+
 		if (AVoxModel* VoxModel = Cast<AVoxModel>(HitResult.GetActor()))
 		{
 			VoxModel->ModifyVoxel(
@@ -0,0 +1,380 @@
+#include "VoxAsset.h"
+
+#include <atomic>
+
+#include "VoxelBrick.h"
+#include "VoxMemory.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Compression.h"
+#include "Serialization/CustomVersion.h"
+
+#if WITH_EDITORONLY_DATA
+#include "EditorFramework/AssetImportData.h"
+#endif
+
+namespace
+{
+	// Layout changes of the native part of UVoxAsset::Serialize
+	struct FVoxAssetVersion
+	{
+		enum Type
+		{
+			BeforeCustomVersionWasAdded = 0,
+
+			// One grid per unique model, older assets hold the flattened scene as their only grid
+			ModelGrids,
+
+			VersionPlusOne,
+			LatestVersion = VersionPlusOne - 1
+		};
+
+		static const FGuid GUID;
+	};
+
+	const FGuid FVoxAssetVersion::GUID(0x5A3C81D2, 0x4F0B47E6, 0x9C2D7A15, 0xB86E04F9);
+	FCustomVersionRegistration GRegisterVoxAssetVersion(FVoxAssetVersion::GUID, FVoxAssetVersion::LatestVersion,
+	                                                    TEXT("VoxAsset"));
+
+	// Maps every brick of the table back to the grid it belongs to
+	TArray<int32> GetBrickGrids(const TArray<FVoxAssetGrid>& Grids, int32 NumBricks)
+	{
+		TArray<int32> BrickGrids;
+		BrickGrids.Init(INDEX_NONE, NumBricks);
+
+		for (int32 GridIndex = 0; GridIndex < Grids.Num(); GridIndex++)
+		{
+			const FIntVector BrickCount = VoxelBrick::GetBrickCount(Grids[GridIndex].Dimensions);
+			const int32 GridBricks = BrickCount.X * BrickCount.Y * BrickCount.Z;
+
+			for (int32 i = 0; i < GridBricks && Grids[GridIndex].FirstBrick + i < NumBricks; i++)
+			{
+				BrickGrids[Grids[GridIndex].FirstBrick + i] = GridIndex;
+			}
+		}
+
+		return BrickGrids;
+	}
+
+	// Owns everything the decode needs so the worker never touches the asset itself
+	struct FVoxBrickDecodeJob
+	{
+		TPromise<FVoxImportResult> Promise;
+		TSharedPtr<FVoxImportState> State;
+		TArray<FVoxAssetGrid> Grids;
+		TArray<FVoxBrickEntry> BrickTable;
+		FVoxImportResult Scene;
+		bool bFlatten = true;
+
+		void Run(const uint8* Payload, int64 PayloadSize, bool bReadFailed)
+		{
+			FVoxImportResult Result = MoveTemp(Scene);
+			Result.bSuccess = !bReadFailed && !State->IsCancelled() && Decode(Payload, PayloadSize, Result) &&
+				(!bFlatten || UVoxImporter::FlattenScene(Result, State.Get(), 0.5f));
+
+			State->Finish(Result.bSuccess);
+			Promise.SetValue(MoveTemp(Result));
+		}
+
+		bool Decode(const uint8* Payload, int64 PayloadSize, FVoxImportResult& Result)
+		{
+			const TArray<int32> BrickGrids = GetBrickGrids(Grids, BrickTable.Num());
+
+			Result.Models.SetNum(Grids.Num());
+			for (int32 GridIndex = 0; GridIndex < Grids.Num(); GridIndex++)
+			{
+				const FIntVector& Dims = Grids[GridIndex].Dimensions;
+				Result.Models[GridIndex].Dimensions = Dims;
+				Result.Models[GridIndex].ColorIndices.SetNumUninitialized(Dims.X * Dims.Y * Dims.Z);
+			}
+
+			std::atomic<bool> bFailed{false};
+			std::atomic<int32> NumDecoded{0};
+
+			ParallelFor(BrickTable.Num(), [&](int32 BrickIndex)
+			{
+				LLM_SCOPE_BYTAG(Voxel_Blocks);
+
+				if (bFailed || State->IsCancelled() || BrickGrids[BrickIndex] == INDEX_NONE)
+				{
+					bFailed = true;
+					return;
+				}
+
+				const FVoxBrickEntry& Entry = BrickTable[BrickIndex];
+				uint8 Voxels[VoxelBrick::NumVoxels];
+
+				if (Entry.CompressedSize == 0)
+				{
+					FMemory::Memset(Voxels, Entry.UniformValue, sizeof(Voxels));
+				}
+				else if (!Payload || Entry.Offset + static_cast<int64>(Entry.CompressedSize) > PayloadSize ||
+					!FCompression::UncompressMemory(NAME_Oodle, Voxels, VoxelBrick::NumVoxels,
+					                                Payload + Entry.Offset, Entry.CompressedSize))
+				{
+					bFailed = true;
+					return;
+				}
+
+				const FVoxAssetGrid& Grid = Grids[BrickGrids[BrickIndex]];
+				FVoxModelGrid& Model = Result.Models[BrickGrids[BrickIndex]];
+				const FIntVector& Dims = Grid.Dimensions;
+
+				const FIntVector BrickCount = VoxelBrick::GetBrickCount(Dims);
+				const FIntVector Origin = VoxelBrick::GetBrickCoord(BrickIndex - Grid.FirstBrick, BrickCount) *
+					VoxelBrick::Size;
+				const FIntVector End(
+					FMath::Min(Origin.X + VoxelBrick::Size, Dims.X),
+					FMath::Min(Origin.Y + VoxelBrick::Size, Dims.Y),
+					FMath::Min(Origin.Z + VoxelBrick::Size, Dims.Z)
+				);
+
+				for (int32 z = Origin.Z; z < End.Z; z++)
+				{
+					for (int32 y = Origin.Y; y < End.Y; y++)
+					{
+						for (int32 x = Origin.X; x < End.X; x++)
+						{
+							Model.ColorIndices[x + y * Dims.X + z * Dims.X * Dims.Y] =
+								Voxels[VoxelBrick::GetLocalIndex(x - Origin.X, y - Origin.Y, z - Origin.Z)];
+						}
+					}
+				}
+
+				State->Progress = 0.5f * ++NumDecoded / BrickTable.Num();
+			});
+
+			return !bFailed;
+		}
+	};
+}
+
+void UVoxAsset::PostInitProperties()
+{
+#if WITH_EDITORONLY_DATA
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		AssetImportData = NewObject<UAssetImportData>(this, TEXT("AssetImportData"));
+	}
+#endif
+
+	Super::PostInitProperties();
+}
+
+void UVoxAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FVoxAssetVersion::GUID);
+
+	if (Ar.CustomVer(FVoxAssetVersion::GUID) >= FVoxAssetVersion::ModelGrids)
+	{
+		Ar << Grids;
+	}
+	else if (Ar.IsLoading())
+	{
+		// The bricks are the flattened scene, placed once where it starts. The old instances point at models
+		// that were never stored.
+		Grids = {FVoxAssetGrid{ModelDimensions, 0}};
+
+		FVoxSceneModel Model;
+		Model.Size = ModelDimensions;
+
+		FVoxSceneInstance Instance;
+		Instance.ModelIndex = 0;
+		Instance.Transform.SetOrigin(FVector(SceneOrigin));
+
+		SceneGraph.Models = {Model};
+		SceneGraph.Instances = {Instance};
+		SceneGraph.Groups.Reset();
+	}
+
+	Ar << BrickTable;
+
+	if (Ar.IsSaving())
+	{
+		// Keep the bricks out of the export, they are only read when a model asks for them
+		BrickBulkData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+	}
+
+	BrickBulkData.Serialize(Ar, this);
+}
+
+bool UVoxAsset::BuildPayload(const FVoxImportResult& Result, FVoxAssetPayload& OutPayload)
+{
+	if (!Result.bSuccess)
+		return false;
+
+	OutPayload.ModelDimensions = Result.ModelDimensions;
+	OutPayload.SceneOrigin = Result.SceneOrigin;
+	OutPayload.Palette = Result.Palette;
+	OutPayload.SceneGraph = Result.SceneGraph;
+
+	int32 NumBricks = 0;
+	for (const FVoxModelGrid& Model : Result.Models)
+	{
+		FVoxAssetGrid& Grid = OutPayload.Grids.AddDefaulted_GetRef();
+		Grid.Dimensions = Model.Dimensions;
+		Grid.FirstBrick = NumBricks;
+
+		const FIntVector BrickCount = VoxelBrick::GetBrickCount(Model.Dimensions);
+		NumBricks += BrickCount.X * BrickCount.Y * BrickCount.Z;
+	}
+
+	const TArray<int32> BrickGrids = GetBrickGrids(OutPayload.Grids, NumBricks);
+	OutPayload.BrickTable.SetNum(NumBricks);
+
+	// Bricks are compressed independently so each one can be decoded on its own
+	TArray<TArray<uint8>> Compressed;
+	Compressed.SetNum(NumBricks);
+
+	std::atomic<bool> bFailed{false};
+
+	ParallelFor(NumBricks, [&](int32 BrickIndex)
+	{
+		LLM_SCOPE_BYTAG(Voxel_Blocks);
+
+		const FVoxAssetGrid& Grid = OutPayload.Grids[BrickGrids[BrickIndex]];
+		const FVoxModelGrid& Model = Result.Models[BrickGrids[BrickIndex]];
+		const FIntVector& Dims = Grid.Dimensions;
+
+		const FIntVector Origin = VoxelBrick::GetBrickCoord(BrickIndex - Grid.FirstBrick,
+		                                                    VoxelBrick::GetBrickCount(Dims)) * VoxelBrick::Size;
+
+		uint8 Voxels[VoxelBrick::NumVoxels];
+		bool bUniform = true;
+
+		for (int32 z = 0; z < VoxelBrick::Size; z++)
+		{
+			for (int32 y = 0; y < VoxelBrick::Size; y++)
+			{
+				for (int32 x = 0; x < VoxelBrick::Size; x++)
+				{
+					const FIntVector Pos = Origin + FIntVector(x, y, z);
+					const bool bInBounds = Pos.X < Dims.X && Pos.Y < Dims.Y && Pos.Z < Dims.Z;
+
+					const int32 LocalIndex = VoxelBrick::GetLocalIndex(x, y, z);
+					Voxels[LocalIndex] = bInBounds
+						                     ? Model.ColorIndices[Pos.X + Pos.Y * Dims.X + Pos.Z * Dims.X * Dims.Y]
+						                     : 0;
+
+					bUniform &= Voxels[LocalIndex] == Voxels[0];
+				}
+			}
+		}
+
+		FVoxBrickEntry& Entry = OutPayload.BrickTable[BrickIndex];
+		if (bUniform)
+		{
+			Entry.UniformValue = Voxels[0];
+			return;
+		}
+
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Oodle, VoxelBrick::NumVoxels);
+		Compressed[BrickIndex].SetNumUninitialized(CompressedSize);
+
+		if (!FCompression::CompressMemory(NAME_Oodle, Compressed[BrickIndex].GetData(), CompressedSize,
+		                                  Voxels, VoxelBrick::NumVoxels))
+		{
+			bFailed = true;
+			return;
+		}
+
+		Compressed[BrickIndex].SetNum(CompressedSize);
+		Entry.CompressedSize = CompressedSize;
+	});
+
+	if (bFailed)
+		return false;
+
+	int64 TotalSize = 0;
+	for (const TArray<uint8>& Brick : Compressed)
+	{
+		TotalSize += Brick.Num();
+	}
+
+	OutPayload.CompressedBricks.Reset(TotalSize);
+
+	for (int32 BrickIndex = 0; BrickIndex < NumBricks; BrickIndex++)
+	{
+		OutPayload.BrickTable[BrickIndex].Offset = OutPayload.CompressedBricks.Num();
+		OutPayload.CompressedBricks.Append(Compressed[BrickIndex]);
+	}
+
+	return true;
+}
+
+void UVoxAsset::ApplyPayload(FVoxAssetPayload&& Payload)
+{
+	ModelDimensions = Payload.ModelDimensions;
+	SceneOrigin = Payload.SceneOrigin;
+	Palette = MoveTemp(Payload.Palette);
+	SceneGraph = MoveTemp(Payload.SceneGraph);
+	Grids = MoveTemp(Payload.Grids);
+	BrickTable = MoveTemp(Payload.BrickTable);
+
+	BrickBulkData.Lock(LOCK_READ_WRITE);
+	void* Data = BrickBulkData.Realloc(Payload.CompressedBricks.Num());
+	FMemory::Memcpy(Data, Payload.CompressedBricks.GetData(), Payload.CompressedBricks.Num());
+	BrickBulkData.Unlock();
+}
+
+TFuture<FVoxImportResult> UVoxAsset::LoadVoxelDataAsync(const TSharedRef<FVoxImportState>& State, bool bFlatten) const
+{
+	check(IsInGameThread());
+
+	const TSharedRef<FVoxBrickDecodeJob> Job = MakeShared<FVoxBrickDecodeJob>();
+	Job->State = State;
+	Job->Grids = Grids;
+	Job->BrickTable = BrickTable;
+	Job->bFlatten = bFlatten;
+	Job->Scene.ModelDimensions = ModelDimensions;
+	Job->Scene.SceneOrigin = SceneOrigin;
+	Job->Scene.Palette = Palette;
+	Job->Scene.SceneGraph = SceneGraph;
+
+	TFuture<FVoxImportResult> Future = Job->Promise.GetFuture();
+
+	const int64 PayloadSize = BrickBulkData.GetBulkDataSize();
+
+	if (PayloadSize == 0 || BrickBulkData.IsBulkDataLoaded())
+	{
+		// Editor and inline payloads are already resident, hand the worker its own copy
+		TArray<uint8> Payload;
+		if (PayloadSize > 0)
+		{
+			Payload.SetNumUninitialized(PayloadSize);
+			FMemory::Memcpy(Payload.GetData(), BrickBulkData.LockReadOnly(), PayloadSize);
+			BrickBulkData.Unlock();
+		}
+
+		Async(EAsyncExecution::ThreadPool, [Job, Payload = MoveTemp(Payload)]()
+		{
+			Job->Run(Payload.GetData(), Payload.Num(), false);
+		});
+
+		return Future;
+	}
+
+	FBulkDataIORequestCallBack Callback = [Job](bool bWasCancelled, IBulkDataIORequest* Request)
+	{
+		// The request can't be deleted from inside its own callback
+		Async(EAsyncExecution::ThreadPool, [Job, bWasCancelled, Request]()
+		{
+			Request->WaitCompletion();
+
+			uint8* Payload = bWasCancelled ? nullptr : Request->GetReadResults();
+			Job->Run(Payload, Request->GetSize(), Payload == nullptr);
+
+			FMemory::Free(Payload);
+			delete Request;
+		});
+	};
+
+	if (!BrickBulkData.CreateStreamingRequest(AIOP_BelowNormal, &Callback, nullptr))
+	{
+		Job->Run(nullptr, 0, true);
+	}
+
+	return Future;
+}
@@ -0,0 +1,194 @@
+#include "VoxBlockVolume.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Hash/CityHash.h"
+
+static int32 GVoxBrickLayout = 1;
+static FAutoConsoleVariableRef CVarVoxBrickLayout(
+	TEXT("vox.BrickLayout"),
+	GVoxBrickLayout,
+	TEXT("Voxel order inside the bricks of volumes created from now on. 0 linear, 1 Morton (Z-order)."));
+
+FVoxBlockVolume::FVoxBlockVolume(const FIntVector& InDimensions, const TArray<EBlock>& Blocks, EVoxBrickLayout InLayout)
+	: Layout(InLayout), Dimensions(InDimensions), BrickCount(VoxelBrick::GetBrickCount(InDimensions))
+{
+	check(Blocks.Num() == Dimensions.X * Dimensions.Y * Dimensions.Z);
+
+	TMap<EBlock, TSharedPtr<FBrick, ESPMode::ThreadSafe>> UniformBricks;
+
+	Bricks.SetNum(BrickCount.X * BrickCount.Y * BrickCount.Z);
+
+	for (int32 BrickIndex = 0; BrickIndex < Bricks.Num(); BrickIndex++)
+	{
+		const FIntVector Origin = VoxelBrick::GetBrickCoord(BrickIndex, BrickCount) * VoxelBrick::Size;
+
+		// Cells past the grid edge are padded with air and never read
+		FBrick Brick;
+		bool bUniform = true;
+
+		for (int32 z = 0; z < VoxelBrick::Size; z++)
+		{
+			for (int32 y = 0; y < VoxelBrick::Size; y++)
+			{
+				for (int32 x = 0; x < VoxelBrick::Size; x++)
+				{
+					const FIntVector Pos = Origin + FIntVector(x, y, z);
+					const int32 LocalIndex = GetLocalIndex(x, y, z);
+
+					Brick[LocalIndex] = IsInBounds(Pos.X, Pos.Y, Pos.Z)
+						                    ? Blocks[Pos.X + Pos.Y * Dimensions.X + Pos.Z * Dimensions.X * Dimensions.Y]
+						                    : EBlock::Air;
+
+					bUniform &= Brick[LocalIndex] == Brick[0];
+				}
+			}
+		}
+
+		if (!bUniform)
+		{
+			Bricks[BrickIndex] = MakeShared<FBrick, ESPMode::ThreadSafe>(Brick);
+			continue;
+		}
+
+		TSharedPtr<FBrick, ESPMode::ThreadSafe>& Uniform = UniformBricks.FindOrAdd(Brick[0]);
+		if (!Uniform.IsValid())
+		{
+			Uniform = MakeShared<FBrick, ESPMode::ThreadSafe>(Brick);
+		}
+		Bricks[BrickIndex] = Uniform;
+	}
+}
+
+void FVoxBlockVolume::Set(int32 X, int32 Y, int32 Z, EBlock Block)
+{
+	if (!IsInBounds(X, Y, Z))
+		return;
+
+	const FIntVector BrickCoord(X / VoxelBrick::Size, Y / VoxelBrick::Size, Z / VoxelBrick::Size);
+	TSharedPtr<FBrick, ESPMode::ThreadSafe>& Brick = Bricks[VoxelBrick::GetBrickIndex(BrickCoord, BrickCount)];
+
+	const int32 LocalIndex = GetLocalIndex(X % VoxelBrick::Size, Y % VoxelBrick::Size, Z % VoxelBrick::Size);
+	if ((*Brick)[LocalIndex] == Block)
+		return;
+
+	if (!Brick.IsUnique())
+	{
+		Brick = MakeShared<FBrick, ESPMode::ThreadSafe>(*Brick);
+	}
+
+	(*Brick)[LocalIndex] = Block;
+}
+
+EVoxBrickLayout FVoxBlockVolume::GetDefaultLayout()
+{
+	return GVoxBrickLayout == 0 ? EVoxBrickLayout::Linear : EVoxBrickLayout::Morton;
+}
+
+uint64 FVoxBlockVolume::GetContentHash() const
+{
+	uint64 Hash = CityHash64(reinterpret_cast<const char*>(&Dimensions), sizeof(Dimensions));
+	Hash = CityHash128to64(Uint128_64(Hash, static_cast<uint64>(Layout)));
+
+	// Uniform bricks share one allocation, runs of them are only hashed once
+	const FBrick* Previous = nullptr;
+	uint64 BrickHash = 0;
+
+	for (const TSharedPtr<FBrick, ESPMode::ThreadSafe>& Brick : Bricks)
+	{
+		if (Brick.Get() != Previous)
+		{
+			Previous = Brick.Get();
+			BrickHash = CityHash64(reinterpret_cast<const char*>(Brick->GetData()), sizeof(FBrick));
+		}
+
+		Hash = CityHash128to64(Uint128_64(Hash, BrickHash));
+	}
+
+	return Hash;
+}
+
+SIZE_T FVoxBlockVolume::GetAllocatedSize(TSet<const void*>& CountedBricks) const
+{
+	SIZE_T Size = Bricks.GetAllocatedSize();
+
+	for (const TSharedPtr<FBrick, ESPMode::ThreadSafe>& Brick : Bricks)
+	{
+		bool bAlreadyCounted = false;
+		CountedBricks.Add(Brick.Get(), &bAlreadyCounted);
+
+		if (!bAlreadyCounted)
+		{
+			Size += sizeof(FBrick);
+		}
+	}
+
+	return Size;
+}
+
+void FVoxBlockVolume::Reset()
+{
+	Dimensions = FIntVector::ZeroValue;
+	BrickCount = FIntVector::ZeroValue;
+	Bricks.Empty();
+}
+
+// Times a mesher style sweep, every block read together with its neighbour along the sweep axis
+static FAutoConsoleCommand CmdBenchmarkBrickLayout(
+	TEXT("vox.BenchmarkBrickLayout"),
+	TEXT("Sweeps a random terrain volume along each axis in both brick layouts and logs the times. Optional argument is the edge length, 128 by default."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Edge = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 16, 512) : 128;
+		const FIntVector Dimensions(Edge);
+
+		// Rolling heights with caves, so bricks are neither all uniform nor pure noise
+		FRandomStream Random(1337);
+		TArray<EBlock> Blocks;
+		Blocks.SetNumUninitialized(Edge * Edge * Edge);
+
+		for (int32 z = 0; z < Edge; z++)
+		{
+			for (int32 y = 0; y < Edge; y++)
+			{
+				for (int32 x = 0; x < Edge; x++)
+				{
+					const float Height = Edge * (0.5f + 0.25f * FMath::Sin(x * 0.05f) * FMath::Cos(y * 0.07f));
+					const bool bSolid = z < Height && Random.FRand() > 0.1f;
+					Blocks[x + y * Edge + z * Edge * Edge] = bSolid ? EBlock::Stone : EBlock::Air;
+				}
+			}
+		}
+
+		for (const EVoxBrickLayout Layout : {EVoxBrickLayout::Linear, EVoxBrickLayout::Morton})
+		{
+			const FVoxBlockVolume Volume(Dimensions, Blocks, Layout);
+
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				const int32 Axis1 = (Axis + 1) % 3;
+				const int32 Axis2 = (Axis + 2) % 3;
+
+				int32 Faces = 0;
+				const double Start = FPlatformTime::Seconds();
+
+				// Same loop order as the chunk mesher, the sweep axis outermost and Axis1 innermost
+				FIntVector Cell;
+				for (Cell[Axis] = 0; Cell[Axis] < Edge; Cell[Axis]++)
+				{
+					for (Cell[Axis2] = 0; Cell[Axis2] < Edge; Cell[Axis2]++)
+					{
+						for (Cell[Axis1] = 0; Cell[Axis1] < Edge; Cell[Axis1]++)
+						{
+							EBlock Current, Next;
+							Volume.GetWithNeighbour(Cell.X, Cell.Y, Cell.Z, Axis, 1, Current, Next);
+							Faces += (Current == EBlock::Air) != (Next == EBlock::Air);
+						}
+					}
+				}
+
+				UE_LOG(LogTemp, Display, TEXT("%s bricks, sweep along %c: %.2f ms, %d faces"),
+				       Layout == EVoxBrickLayout::Morton ? TEXT("Morton") : TEXT("Linear"), TEXT('X') + Axis,
+				       (FPlatformTime::Seconds() - Start) * 1000.0, Faces);
+			}
+		}
+	}));
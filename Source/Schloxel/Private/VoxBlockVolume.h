@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+#include "Enums.h"
+#include "VoxelBrick.h"
+
+// Order of the voxels inside a brick
+enum class EVoxBrickLayout : uint8
+{
+	Linear,
+	Morton
+};
+
+/**
+ * Block grid stored as reference counted bricks. Copies share every brick, a write clones only the
+ * brick it lands in, so copies are cheap snapshots that stay valid while the original is edited.
+ */
+class FVoxBlockVolume
+{
+public:
+	FVoxBlockVolume() = default;
+
+	// Blocks in x -> y -> z order. Uniform bricks of the same block share one allocation.
+	FVoxBlockVolume(const FIntVector& InDimensions, const TArray<EBlock>& Blocks,
+	                EVoxBrickLayout InLayout = GetDefaultLayout());
+
+	// Picked by vox.BrickLayout
+	static EVoxBrickLayout GetDefaultLayout();
+
+	const FIntVector& GetDimensions() const { return Dimensions; }
+	bool IsEmpty() const { return Bricks.IsEmpty(); }
+
+	bool IsInBounds(int32 X, int32 Y, int32 Z) const
+	{
+		return X >= 0 && Y >= 0 && Z >= 0 && X < Dimensions.X && Y < Dimensions.Y && Z < Dimensions.Z;
+	}
+
+	// Air outside the grid
+	EBlock Get(int32 X, int32 Y, int32 Z) const
+	{
+		if (!IsInBounds(X, Y, Z))
+			return EBlock::Air;
+
+		const FIntVector Brick(X / VoxelBrick::Size, Y / VoxelBrick::Size, Z / VoxelBrick::Size);
+		return (*Bricks[VoxelBrick::GetBrickIndex(Brick, BrickCount)])[GetLocalIndex(
+			X % VoxelBrick::Size, Y % VoxelBrick::Size, Z % VoxelBrick::Size)];
+	}
+
+	// The block and its neighbour one step along the axis, read from one brick lookup when both share it
+	void GetWithNeighbour(int32 X, int32 Y, int32 Z, int32 Axis, int32 Step, EBlock& OutBlock, EBlock& OutNeighbour) const
+	{
+		const FIntVector Local(X % VoxelBrick::Size, Y % VoxelBrick::Size, Z % VoxelBrick::Size);
+		const int32 Next = Local[Axis] + Step;
+
+		if (!IsInBounds(X, Y, Z) || Next < 0 || Next >= VoxelBrick::Size || !IsInBounds(
+			X + (Axis == 0) * Step, Y + (Axis == 1) * Step, Z + (Axis == 2) * Step))
+		{
+			OutBlock = Get(X, Y, Z);
+			OutNeighbour = Get(X + (Axis == 0) * Step, Y + (Axis == 1) * Step, Z + (Axis == 2) * Step);
+			return;
+		}
+
+		const FIntVector Brick(X / VoxelBrick::Size, Y / VoxelBrick::Size, Z / VoxelBrick::Size);
+		const FBrick& Blocks = *Bricks[VoxelBrick::GetBrickIndex(Brick, BrickCount)];
+
+		const int32 Index = GetLocalIndex(Local.X, Local.Y, Local.Z);
+		OutBlock = Blocks[Index];
+		OutNeighbour = Blocks[Layout == EVoxBrickLayout::Morton
+			                      ? VoxelBrick::StepMortonIndex(Index, Axis, Step)
+			                      : Index + Step * (Axis == 0 ? 1 : Axis == 1 ? VoxelBrick::Size : VoxelBrick::Size * VoxelBrick::Size)];
+	}
+
+	// Game thread only, clones the brick first if any other volume still references it
+	void Set(int32 X, int32 Y, int32 Z, EBlock Block);
+
+	// Same for equal dimensions, layout and blocks, wherever the bricks live
+	uint64 GetContentHash() const;
+
+	// Bricks already in CountedBricks are skipped and the rest added, so a brick shared by several volumes is
+	// only counted by the first
+	SIZE_T GetAllocatedSize(TSet<const void*>& CountedBricks) const;
+
+	void Reset();
+
+private:
+	using FBrick = TStaticArray<EBlock, VoxelBrick::NumVoxels>;
+
+	int32 GetLocalIndex(int32 X, int32 Y, int32 Z) const
+	{
+		return Layout == EVoxBrickLayout::Morton ? VoxelBrick::GetMortonIndex(X, Y, Z) : VoxelBrick::GetLocalIndex(X, Y, Z);
+	}
+
+	EVoxBrickLayout Layout = EVoxBrickLayout::Morton;
+	FIntVector Dimensions = FIntVector::ZeroValue;
+	FIntVector BrickCount = FIntVector::ZeroValue;
+
+	TArray<TSharedPtr<FBrick, ESPMode::ThreadSafe>> Bricks;
+};
@@ -0,0 +1,173 @@
+#include "VoxColumns.h"
+
+#include "Algo/BinarySearch.h"
+#include "Hash/CityHash.h"
+
+FVoxColumns::FVoxColumns(const FIntVector& InSize, TConstArrayView<uint16> Heights, EBlock Solid)
+	: Size(InSize)
+{
+	check(Heights.Num() == Size.X * Size.Y);
+
+	Offsets.SetNumUninitialized(Heights.Num() + 1);
+	Runs.Reserve(Heights.Num() * 2);
+
+	for (int32 Column = 0; Column < Heights.Num(); Column++)
+	{
+		Offsets[Column] = Runs.Num();
+
+		const uint16 Height = FMath::Min<uint16>(Heights[Column], Size.Z);
+		if (Height > 0)
+		{
+			Runs.Add({Height, Solid});
+		}
+		if (Height < Size.Z)
+		{
+			Runs.Add({static_cast<uint16>(Size.Z), EBlock::Air});
+		}
+	}
+
+	Offsets.Last() = Runs.Num();
+}
+
+EBlock FVoxColumns::Get(int32 X, int32 Y, int32 Z) const
+{
+	const TConstArrayView<FVoxRun> Column = GetColumn(X, Y);
+	if (Column.IsEmpty() || Z < 0 || Z >= Size.Z)
+		return EBlock::Air;
+
+	return Column[Algo::UpperBoundBy(Column, Z, &FVoxRun::End)].Block;
+}
+
+bool FVoxColumns::Set(int32 X, int32 Y, int32 Z, EBlock Block)
+{
+	const TConstArrayView<FVoxRun> Column = GetColumn(X, Y);
+	if (Column.IsEmpty() || Z < 0 || Z >= Size.Z)
+		return true;
+
+	const int32 Hit = Algo::UpperBoundBy(Column, Z, &FVoxRun::End);
+	if (Column[Hit].Block == Block)
+		return true;
+
+	// The hit run is split around the voxel, then neighbours of the same block are merged
+	TArray<FVoxRun, TInlineAllocator<MaxRuns + 2>> Edited;
+	const int32 Start = Hit > 0 ? Column[Hit - 1].End : 0;
+
+	for (int32 Run = 0; Run < Column.Num(); Run++)
+	{
+		if (Run != Hit)
+		{
+			Edited.Add(Column[Run]);
+			continue;
+		}
+
+		if (Z > Start)
+		{
+			Edited.Add({static_cast<uint16>(Z), Column[Hit].Block});
+		}
+		Edited.Add({static_cast<uint16>(Z + 1), Block});
+		if (Z + 1 < Column[Hit].End)
+		{
+			Edited.Add(Column[Hit]);
+		}
+	}
+
+	int32 Merged = 0;
+	for (int32 Run = 1; Run < Edited.Num(); Run++)
+	{
+		if (Edited[Run].Block == Edited[Merged].Block)
+		{
+			Edited[Merged].End = Edited[Run].End;
+		}
+		else
+		{
+			Edited[++Merged] = Edited[Run];
+		}
+	}
+	Edited.SetNum(Merged + 1);
+
+	if (Edited.Num() > MaxRuns)
+		return false;
+
+	const int32 ColumnIndex = X + Y * Size.X;
+	const int32 Offset = Offsets[ColumnIndex];
+	const int32 Growth = Edited.Num() - Column.Num();
+
+	// Moving a boundary keeps the run count, only splits and merges shift the following columns
+	if (Growth > 0)
+	{
+		Runs.InsertUninitialized(Offset, Growth);
+	}
+	else if (Growth < 0)
+	{
+		Runs.RemoveAt(Offset, -Growth, EAllowShrinking::No);
+	}
+
+	FMemory::Memcpy(Runs.GetData() + Offset, Edited.GetData(), Edited.Num() * sizeof(FVoxRun));
+
+	if (Growth != 0)
+	{
+		for (int32 Next = ColumnIndex + 1; Next < Offsets.Num(); Next++)
+		{
+			Offsets[Next] += Growth;
+		}
+	}
+
+	return true;
+}
+
+bool FVoxColumns::IsHeightfield() const
+{
+	for (int32 Column = 0; Column + 1 < Offsets.Num(); Column++)
+	{
+		const int32 NumRuns = Offsets[Column + 1] - Offsets[Column];
+		if (NumRuns > 2 || (NumRuns == 2 && (Runs[Offsets[Column]].Block == EBlock::Air ||
+			Runs[Offsets[Column] + 1].Block != EBlock::Air)))
+			return false;
+	}
+
+	return true;
+}
+
+FVoxBlockVolume FVoxColumns::ToVolume() const
+{
+	TArray<EBlock> Blocks;
+	Blocks.SetNumUninitialized(Size.X * Size.Y * Size.Z);
+
+	for (int32 y = 0; y < Size.Y; y++)
+	{
+		for (int32 x = 0; x < Size.X; x++)
+		{
+			int32 z = 0;
+			for (const FVoxRun& Run : GetColumn(x, y))
+			{
+				for (; z < Run.End; z++)
+				{
+					Blocks[x + y * Size.X + z * Size.X * Size.Y] = Run.Block;
+				}
+			}
+		}
+	}
+
+	return FVoxBlockVolume(Size, Blocks);
+}
+
+uint64 FVoxColumns::GetContentHash() const
+{
+	uint64 Hash = CityHash64(reinterpret_cast<const char*>(&Size), sizeof(Size));
+	Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Offsets.GetData()), Offsets.Num() * sizeof(int32), Hash);
+
+	// Field by field, FVoxRun has a padding byte
+	for (const FVoxRun& Run : Runs)
+	{
+		Hash = CityHash128to64(Uint128_64(Hash, Run.End | static_cast<uint64>(Run.Block) << 16));
+	}
+
+	return Hash;
+}
+
+void FVoxColumns::Reset()
+{
+	Size = FIntVector::ZeroValue;
+	Runs.Empty();
+	Offsets.Empty();
+}
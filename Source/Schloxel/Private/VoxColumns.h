@@ -0,0 +1,73 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Enums.h"
+#include "VoxBlockVolume.h"
+
+// Blocks of one column from the previous run's End up to but excluding End
+struct FVoxRun
+{
+	uint16 End;
+	EBlock Block;
+};
+
+/**
+ * Chunk blocks as run length encoded columns, x -> y. Every column is covered by its runs from 0 to Size.Z.
+ * Generated terrain is one or two runs per column, edits split and merge runs in place.
+ */
+class FVoxColumns
+{
+public:
+	// Columns with more runs than this are better stored dense
+	static constexpr int32 MaxRuns = 8;
+
+	FVoxColumns() = default;
+
+	// Solid below the height, air above, heights x -> y
+	FVoxColumns(const FIntVector& InSize, TConstArrayView<uint16> Heights, EBlock Solid);
+
+	const FIntVector& GetSize() const { return Size; }
+	bool IsEmpty() const { return Offsets.IsEmpty(); }
+
+	// Empty outside the chunk, which reads as air all the way up
+	TConstArrayView<FVoxRun> GetColumn(int32 X, int32 Y) const
+	{
+		if (X < 0 || Y < 0 || X >= Size.X || Y >= Size.Y)
+			return {};
+
+		const int32 Column = X + Y * Size.X;
+		return TConstArrayView<FVoxRun>(Runs.GetData() + Offsets[Column], Offsets[Column + 1] - Offsets[Column]);
+	}
+
+	// Binary search over the runs of the column, air outside the chunk
+	EBlock Get(int32 X, int32 Y, int32 Z) const;
+
+	// False if the column would need more than MaxRuns, nothing is changed then
+	bool Set(int32 X, int32 Y, int32 Z, EBlock Block);
+
+	// True while every column is solid below some height and air above it
+	bool IsHeightfield() const;
+
+	// Top of the solid run at the bottom of the column, only meaningful for heightfields
+	int32 GetHeight(int32 X, int32 Y) const
+	{
+		const TConstArrayView<FVoxRun> Column = GetColumn(X, Y);
+		return !Column.IsEmpty() && Column[0].Block != EBlock::Air ? Column[0].End : 0;
+	}
+
+	FVoxBlockVolume ToVolume() const;
+
+	// Same for equal sizes and runs
+	uint64 GetContentHash() const;
+
+	SIZE_T GetAllocatedSize() const { return Runs.GetAllocatedSize() + Offsets.GetAllocatedSize(); }
+
+	void Reset();
+
+private:
+	FIntVector Size = FIntVector::ZeroValue;
+
+	// All runs back to back, column i owns [Offsets[i], Offsets[i + 1])
+	TArray<FVoxRun> Runs;
+	TArray<int32> Offsets;
+};
@@ -0,0 +1,301 @@
+#include "VoxExporter.h"
+
+#include "VoxImporter.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+
+namespace
+{
+	constexpr uint32 MakeChunkId(char A, char B, char C, char D)
+	{
+		return A | (B << 8) | (C << 16) | (D << 24);
+	}
+
+	constexpr uint32 ChunkHeaderSize = 12;
+
+	// One tile of the grid, written as a model with its own shape and transform node
+	struct FVoxExportModel
+	{
+		FIntVector Origin;
+		FIntVector Size;
+		uint32 NumVoxels = 0;
+		FString Translation;
+	};
+
+	// Block types map onto the first palette entries, index 0 is empty
+	uint8 ToColorIndex(EBlock Block)
+	{
+		return Block == EBlock::Air || Block == EBlock::Null ? 0 : static_cast<uint8>(Block) - 1;
+	}
+
+	FColor GetBlockColor(uint8 ColorIndex)
+	{
+		switch (static_cast<EBlock>(ColorIndex + 1))
+		{
+		case EBlock::Stone: return FColor(128, 128, 128);
+		case EBlock::Dirt: return FColor(121, 85, 58);
+		case EBlock::Grass: return FColor(86, 158, 60);
+		case EBlock::Lamp: return FColor(255, 214, 120);
+		default: return FColor::White;
+		}
+	}
+
+	class FVoxChunkWriter
+	{
+	public:
+		explicit FVoxChunkWriter(FArchive& InAr) : Ar(InAr)
+		{
+		}
+
+		void WriteHeader(uint32 Id, uint32 ContentSize, uint32 ChildrenSize = 0)
+		{
+			WriteUInt32(Id);
+			WriteUInt32(ContentSize);
+			WriteUInt32(ChildrenSize);
+		}
+
+		void WriteUInt32(uint32 Value)
+		{
+			Ar << Value;
+		}
+
+		void WriteString(const FString& Value)
+		{
+			const auto Ansi = StringCast<ANSICHAR>(*Value);
+			WriteUInt32(Ansi.Length());
+			Ar.Serialize(const_cast<ANSICHAR*>(Ansi.Get()), Ansi.Length());
+		}
+
+		void WriteBytes(const void* Data, int64 Num)
+		{
+			Ar.Serialize(const_cast<void*>(Data), Num);
+		}
+
+	private:
+		FArchive& Ar;
+	};
+}
+
+TFuture<bool> FVoxExporter::SaveVoxFileAsync(const FString& FilePath, const FVoxBlockVolume& Blocks,
+                                             const TSharedRef<FVoxImportState>& State)
+{
+	return Async(EAsyncExecution::ThreadPool, [FilePath, Blocks, State]()
+	{
+		const bool bSaved = SaveVoxFile(FilePath, Blocks, &State.Get());
+		State->Finish(bSaved);
+		return bSaved;
+	});
+}
+
+bool FVoxExporter::SaveVoxFile(const FString& FilePath, const FVoxBlockVolume& Blocks, FVoxImportState* State)
+{
+	const FIntVector& Dims = Blocks.GetDimensions();
+	if (Blocks.IsEmpty())
+		return false;
+
+	// First pass only counts, so every chunk size is known before anything is written
+	TArray<FVoxExportModel> Models;
+
+	for (int32 TileZ = 0; TileZ < Dims.Z; TileZ += MaxModelSize)
+	{
+		for (int32 TileY = 0; TileY < Dims.Y; TileY += MaxModelSize)
+		{
+			for (int32 TileX = 0; TileX < Dims.X; TileX += MaxModelSize)
+			{
+				FVoxExportModel Model;
+				Model.Origin = FIntVector(TileX, TileY, TileZ);
+				Model.Size = FIntVector(
+					FMath::Min(MaxModelSize, Dims.X - TileX),
+					FMath::Min(MaxModelSize, Dims.Y - TileY),
+					FMath::Min(MaxModelSize, Dims.Z - TileZ)
+				);
+
+				for (int32 z = 0; z < Model.Size.Z; z++)
+				{
+					for (int32 y = 0; y < Model.Size.Y; y++)
+					{
+						for (int32 x = 0; x < Model.Size.X; x++)
+						{
+							Model.NumVoxels += ToColorIndex(Blocks.Get(TileX + x, TileY + y, TileZ + z)) != 0;
+						}
+					}
+				}
+
+				if (Model.NumVoxels == 0)
+					continue;
+
+				// MagicaVoxel places models by their center pivot
+				const FIntVector Pivot = Model.Origin + Model.Size / 2;
+				Model.Translation = FString::Printf(TEXT("%d %d %d"), Pivot.X, Pivot.Y, Pivot.Z);
+
+				Models.Add(MoveTemp(Model));
+			}
+		}
+
+		if (State && State->IsCancelled())
+			return false;
+	}
+
+	if (Models.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Nothing to export to %s, the model is empty"), *FilePath);
+		return false;
+	}
+
+	// Node ids follow ogt_vox_write_scene: root transform, root group, shapes, instance transforms
+	const uint32 NumModels = Models.Num();
+	const uint32 FirstShapeNode = 2;
+	const uint32 FirstTransformNode = FirstShapeNode + NumModels;
+
+	// Summed wide, the MAIN chunk can only describe 4 GB of children
+	uint64 ChildrenSize = ChunkHeaderSize + 28;
+	ChildrenSize += ChunkHeaderSize + 12 + 4ull * NumModels;
+	ChildrenSize += (ChunkHeaderSize + 20ull) * NumModels;
+	ChildrenSize += ChunkHeaderSize + 256 * 4;
+
+	for (const FVoxExportModel& Model : Models)
+	{
+		ChildrenSize += ChunkHeaderSize + 12;
+		ChildrenSize += ChunkHeaderSize + 4 + 4ull * Model.NumVoxels;
+		ChildrenSize += ChunkHeaderSize + 38 + Model.Translation.Len();
+	}
+
+	if (ChildrenSize > MAX_uint32)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Can't export %s, %llu bytes of voxels exceed the 4 GB a .vox file can hold"),
+		       *FilePath, ChildrenSize);
+		return false;
+	}
+
+	// Written next to the target and moved over it, a failed export never leaves a truncated file
+	const FString TempPath = FilePath + TEXT(".tmp");
+	TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileWriter(*TempPath));
+	if (!Ar)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to open %s for writing"), *TempPath);
+		return false;
+	}
+
+	FVoxChunkWriter Writer(*Ar);
+
+	Writer.WriteUInt32(MakeChunkId('V', 'O', 'X', ' '));
+	Writer.WriteUInt32(150);
+	Writer.WriteHeader(MakeChunkId('M', 'A', 'I', 'N'), 0, static_cast<uint32>(ChildrenSize));
+
+	TArray<uint8> Voxels;
+
+	for (uint32 ModelIndex = 0; ModelIndex < NumModels; ModelIndex++)
+	{
+		const FVoxExportModel& Model = Models[ModelIndex];
+
+		Writer.WriteHeader(MakeChunkId('S', 'I', 'Z', 'E'), 12);
+		Writer.WriteUInt32(Model.Size.X);
+		Writer.WriteUInt32(Model.Size.Y);
+		Writer.WriteUInt32(Model.Size.Z);
+
+		Writer.WriteHeader(MakeChunkId('X', 'Y', 'Z', 'I'), 4 + 4 * Model.NumVoxels);
+		Writer.WriteUInt32(Model.NumVoxels);
+
+		// Staged one z slice at a time, at most 256 KB
+		Voxels.Reserve(MaxModelSize * MaxModelSize * 4);
+
+		for (int32 z = 0; z < Model.Size.Z; z++)
+		{
+			Voxels.Reset();
+
+			for (int32 y = 0; y < Model.Size.Y; y++)
+			{
+				for (int32 x = 0; x < Model.Size.X; x++)
+				{
+					const uint8 ColorIndex = ToColorIndex(
+						Blocks.Get(Model.Origin.X + x, Model.Origin.Y + y, Model.Origin.Z + z));
+
+					if (ColorIndex != 0)
+					{
+						Voxels.Append({static_cast<uint8>(x), static_cast<uint8>(y), static_cast<uint8>(z), ColorIndex});
+					}
+				}
+			}
+
+			Writer.WriteBytes(Voxels.GetData(), Voxels.Num());
+		}
+
+		if (State)
+		{
+			if (State->IsCancelled())
+			{
+				Ar.Reset();
+				IFileManager::Get().Delete(*TempPath);
+				return false;
+			}
+
+			State->Progress = static_cast<float>(ModelIndex + 1) / (NumModels + 1);
+		}
+	}
+
+	// Root transform and group
+	Writer.WriteHeader(MakeChunkId('n', 'T', 'R', 'N'), 28);
+	Writer.WriteUInt32(0);
+	Writer.WriteUInt32(0);
+	Writer.WriteUInt32(1);
+	Writer.WriteUInt32(MAX_uint32);
+	Writer.WriteUInt32(0);
+	Writer.WriteUInt32(1);
+	Writer.WriteUInt32(0);
+
+	Writer.WriteHeader(MakeChunkId('n', 'G', 'R', 'P'), 12 + 4 * NumModels);
+	Writer.WriteUInt32(1);
+	Writer.WriteUInt32(0);
+	Writer.WriteUInt32(NumModels);
+	for (uint32 ModelIndex = 0; ModelIndex < NumModels; ModelIndex++)
+	{
+		Writer.WriteUInt32(FirstTransformNode + ModelIndex);
+	}
+
+	for (uint32 ModelIndex = 0; ModelIndex < NumModels; ModelIndex++)
+	{
+		Writer.WriteHeader(MakeChunkId('n', 'S', 'H', 'P'), 20);
+		Writer.WriteUInt32(FirstShapeNode + ModelIndex);
+		Writer.WriteUInt32(0);
+		Writer.WriteUInt32(1);
+		Writer.WriteUInt32(ModelIndex);
+		Writer.WriteUInt32(0);
+	}
+
+	for (uint32 ModelIndex = 0; ModelIndex < NumModels; ModelIndex++)
+	{
+		const FString& Translation = Models[ModelIndex].Translation;
+
+		Writer.WriteHeader(MakeChunkId('n', 'T', 'R', 'N'), 38 + Translation.Len());
+		Writer.WriteUInt32(FirstTransformNode + ModelIndex);
+		Writer.WriteUInt32(0);
+		Writer.WriteUInt32(FirstShapeNode + ModelIndex);
+		Writer.WriteUInt32(MAX_uint32);
+		Writer.WriteUInt32(0);
+		Writer.WriteUInt32(1);
+		Writer.WriteUInt32(1);
+		Writer.WriteString(TEXT("_t"));
+		Writer.WriteString(Translation);
+	}
+
+	// .vox stores the palette shifted by one, entry i holds color index i + 1
+	Writer.WriteHeader(MakeChunkId('R', 'G', 'B', 'A'), 256 * 4);
+	for (int32 i = 0; i < 256; i++)
+	{
+		const FColor Color = GetBlockColor(static_cast<uint8>(i + 1));
+		const uint8 Rgba[4] = {Color.R, Color.G, Color.B, Color.A};
+		Writer.WriteBytes(Rgba, sizeof(Rgba));
+	}
+
+	const bool bWritten = Ar->Close() && !Ar->IsError();
+	Ar.Reset();
+
+	if (!bWritten || !IFileManager::Get().Move(*FilePath, *TempPath, true, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write %s"), *FilePath);
+		IFileManager::Get().Delete(*TempPath);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "VoxBlockVolume.h"
+
+struct FVoxImportState;
+
+// Writes block grids back to MagicaVoxel files
+class FVoxExporter
+{
+public:
+	// .vox models can't be larger than this on any axis
+	static constexpr int32 MaxModelSize = 256;
+
+	// Streams the grid to disk on the thread pool. The volume is a snapshot, the caller may keep editing.
+	static TFuture<bool> SaveVoxFileAsync(const FString& FilePath, const FVoxBlockVolume& Blocks,
+	                                      const TSharedRef<FVoxImportState>& State);
+
+	// Thread safe. Chunks are written as they are produced, the file is never held in memory.
+	static bool SaveVoxFile(const FString& FilePath, const FVoxBlockVolume& Blocks, FVoxImportState* State);
+};
@@ -1,99 +1,248 @@
 ﻿#include "VoxImporter.h"
 #include "HAL/FileManager.h"
 #include "Misc/FileHelper.h"
+#include "Async/Async.h"
 
 #define OGT_VOX_IMPLEMENTATION
 #include "ogt_vox.h"
 
+static FMatrix ToMatrix(const ogt_vox_transform& Transform)
+{
+	return FMatrix(
+		FPlane(Transform.m00, Transform.m01, Transform.m02, Transform.m03),
+		FPlane(Transform.m10, Transform.m11, Transform.m12, Transform.m13),
+		FPlane(Transform.m20, Transform.m21, Transform.m22, Transform.m23),
+		FPlane(Transform.m30, Transform.m31, Transform.m32, Transform.m33)
+	);
+}
+
+static void ReadSceneGraph(const ogt_vox_scene* Scene, FVoxImportResult& OutResult)
+{
+	OutResult.Palette.SetNum(256);
+	for (int32 i = 0; i < 256; i++)
+	{
+		const ogt_vox_rgba& Color = Scene->palette.color[i];
+		OutResult.Palette[i] = FColor(Color.r, Color.g, Color.b, Color.a);
+	}
+
+	FVoxSceneGraph& Graph = OutResult.SceneGraph;
+
+	for (uint32 i = 0; i < Scene->num_models; i++)
+	{
+		const ogt_vox_model* Model = Scene->models[i];
+		Graph.Models.AddDefaulted_GetRef().Size = FIntVector(Model->size_x, Model->size_y, Model->size_z);
+	}
+
+	for (uint32 i = 0; i < Scene->num_instances; i++)
+	{
+		const ogt_vox_instance& Instance = Scene->instances[i];
+
+		FVoxSceneInstance& Node = Graph.Instances.AddDefaulted_GetRef();
+		Node.Name = Instance.name ? UTF8_TO_TCHAR(Instance.name) : FString();
+		Node.ModelIndex = Instance.model_index;
+		Node.GroupIndex = Instance.group_index;
+		Node.Transform = ToMatrix(Instance.transform);
+		Node.bHidden = Instance.hidden;
+
+		// MagicaVoxel translates the model's center pivot, keep the origin on its min corner instead
+		const ogt_vox_model* Model = Scene->models[Instance.model_index];
+		const FVector Pivot(Model->size_x / 2, Model->size_y / 2, Model->size_z / 2);
+		Node.Transform.SetOrigin(Node.Transform.GetOrigin() - Node.Transform.TransformVector(Pivot));
+	}
+
+	for (uint32 i = 0; i < Scene->num_groups; i++)
+	{
+		const ogt_vox_group& Group = Scene->groups[i];
+
+		FVoxSceneGroup& Node = Graph.Groups.AddDefaulted_GetRef();
+		Node.Name = Group.name ? UTF8_TO_TCHAR(Group.name) : FString();
+		Node.ParentIndex = Group.parent_group_index == k_invalid_group_index ? INDEX_NONE : Group.parent_group_index;
+		Node.Transform = ToMatrix(Group.transform);
+		Node.bHidden = Group.hidden;
+	}
+}
+
 bool UVoxImporter::LoadVoxFile(const FString& FilePath)
 {
+	FVoxImportResult Result;
+	if (!ImportVoxFile(FilePath, Result, nullptr))
+	{
+		return false;
+	}
+
+	VoxelData = MoveTemp(Result.VoxelData);
+	ModelDimensions = Result.ModelDimensions;
+	return true;
+}
+
+TFuture<FVoxImportResult> UVoxImporter::LoadVoxFileAsync(const FString& FilePath,
+                                                         const TSharedRef<FVoxImportState>& State,
+                                                         bool bFlatten)
+{
+	return Async(EAsyncExecution::ThreadPool, [FilePath, State, bFlatten]()
+	{
+		FVoxImportResult Result;
+		Result.bSuccess = ImportVoxFile(FilePath, Result, &State.Get(), bFlatten);
+		State->Finish(Result.bSuccess);
+		return Result;
+	});
+}
+
+bool UVoxImporter::ImportVoxFile(const FString& FilePath, FVoxImportResult& OutResult, FVoxImportState* State,
+                                bool bFlatten)
+{
+	auto IsCancelled = [State]() { return State && State->IsCancelled(); };
+	auto SetProgress = [State](float Progress) { if (State) State->Progress = Progress; };
+
 	TArray<uint8> FileData;
 	if (!FFileHelper::LoadFileToArray(FileData, *FilePath))
 	{
 		return false;
 	}
 
+	SetProgress(0.1f);
+	if (IsCancelled())
+	{
+		return false;
+	}
+
 	const ogt_vox_scene* Scene = ogt_vox_read_scene(FileData.GetData(), FileData.Num());
 	if (!Scene || Scene->num_models == 0)
 	{
+		if (Scene)
+		{
+			ogt_vox_destroy_scene(Scene);
+		}
+		return false;
+	}
+
+	// The raw file is no longer needed once the scene is parsed
+	FileData.Empty();
+
+	SetProgress(0.3f);
+	if (IsCancelled())
+	{
+		ogt_vox_destroy_scene(Scene);
 		return false;
 	}
 
+	ReadSceneGraph(Scene, OutResult);
+
+	// ogt_vox already deduplicates models, instances only reference them
+	OutResult.Models.SetNum(Scene->num_models);
+	for (uint32 i = 0; i < Scene->num_models; i++)
+	{
+		const ogt_vox_model* Model = Scene->models[i];
+
+		FVoxModelGrid& Grid = OutResult.Models[i];
+		Grid.Dimensions = FIntVector(Model->size_x, Model->size_y, Model->size_z);
+		Grid.ColorIndices = TArray<uint8>(Model->voxel_data, Model->size_x * Model->size_y * Model->size_z);
+	}
+
+	ogt_vox_destroy_scene(Scene);
+
+	if (OutResult.SceneGraph.Instances.IsEmpty())
+	{
+		return false;
+	}
 
 	FIntVector MinBounds(MAX_int32, MAX_int32, MAX_int32);
 	FIntVector MaxBounds(MIN_int32, MIN_int32, MIN_int32);
 
-	for (uint32 i = 0; i < Scene->num_instances; i++)
+	for (const FVoxSceneInstance& Instance : OutResult.SceneGraph.Instances)
 	{
-		const ogt_vox_instance& Instance = Scene->instances[i];
-		const ogt_vox_model* Model = Scene->models[Instance.model_index];
+		if (!OutResult.Models.IsValidIndex(Instance.ModelIndex))
+			continue;
 
+		const FIntVector& ModelSize = OutResult.Models[Instance.ModelIndex].Dimensions;
 
-		FVector Position(Instance.transform.m30, Instance.transform.m31, Instance.transform.m32);
+
+		FVector Position = Instance.Transform.GetOrigin();
 
 
 		MinBounds.X = FMath::Min(MinBounds.X, FMath::FloorToInt(Position.X));
 		MinBounds.Y = FMath::Min(MinBounds.Y, FMath::FloorToInt(Position.Y));
 		MinBounds.Z = FMath::Min(MinBounds.Z, FMath::FloorToInt(Position.Z));
 
-		MaxBounds.X = FMath::Max(MaxBounds.X, FMath::CeilToInt(Position.X + Model->size_x));
-		MaxBounds.Y = FMath::Max(MaxBounds.Y, FMath::CeilToInt(Position.Y + Model->size_y));
-		MaxBounds.Z = FMath::Max(MaxBounds.Z, FMath::CeilToInt(Position.Z + Model->size_z));
+		MaxBounds.X = FMath::Max(MaxBounds.X, FMath::CeilToInt(Position.X + ModelSize.X));
+		MaxBounds.Y = FMath::Max(MaxBounds.Y, FMath::CeilToInt(Position.Y + ModelSize.Y));
+		MaxBounds.Z = FMath::Max(MaxBounds.Z, FMath::CeilToInt(Position.Z + ModelSize.Z));
+	}
+
+	OutResult.SceneOrigin = MinBounds;
+	OutResult.ModelDimensions = MaxBounds - MinBounds;
+
+	if (bFlatten && !FlattenScene(OutResult, State, 0.4f))
+	{
+		return false;
 	}
 
+	OutResult.bSuccess = true;
+	return true;
+}
 
-	ModelDimensions = MaxBounds - MinBounds;
-	const int32 TotalVoxels = ModelDimensions.X * ModelDimensions.Y * ModelDimensions.Z;
-	VoxelData.SetNum(TotalVoxels, EAllowShrinking::No);
+bool UVoxImporter::FlattenScene(FVoxImportResult& Result, FVoxImportState* State, float ProgressStart)
+{
+	const FIntVector& Dimensions = Result.ModelDimensions;
+	TArray<EBlock>& Voxels = Result.VoxelData;
+
+	const int32 TotalVoxels = Dimensions.X * Dimensions.Y * Dimensions.Z;
+	Voxels.SetNum(TotalVoxels, EAllowShrinking::No);
 
 	// Initialize all to Air
 	for (int32 i = 0; i < TotalVoxels; i++)
 	{
-		VoxelData[i] = EBlock::Air;
+		Voxels[i] = EBlock::Air;
 	}
 
+	const TArray<FVoxSceneInstance>& Instances = Result.SceneGraph.Instances;
 
-	for (uint32 i = 0; i < Scene->num_instances; i++)
+	for (int32 i = 0; i < Instances.Num(); i++)
 	{
-		const ogt_vox_instance& Instance = Scene->instances[i];
-		const ogt_vox_model* Model = Scene->models[Instance.model_index];
+		if (State && State->IsCancelled())
+		{
+			return false;
+		}
+
+		if (State)
+		{
+			State->Progress = ProgressStart + (1.0f - ProgressStart) * i / Instances.Num();
+		}
 
-		// Extract rotation matrix
-		FMatrix RotationMatrix(
-			FVector(Instance.transform.m00, Instance.transform.m01, Instance.transform.m02),
-			FVector(Instance.transform.m10, Instance.transform.m11, Instance.transform.m12),
-			FVector(Instance.transform.m20, Instance.transform.m21, Instance.transform.m22),
-			FVector::ZeroVector
-		);
+		const FVoxSceneInstance& Instance = Instances[i];
+		if (!Result.Models.IsValidIndex(Instance.ModelIndex))
+			continue;
 
-		FVector Position(Instance.transform.m30, Instance.transform.m31, Instance.transform.m32);
-		Position -= FVector(MinBounds);
+		const FVoxModelGrid& Model = Result.Models[Instance.ModelIndex];
 
+		FVector Position = Instance.Transform.GetOrigin();
+		Position -= FVector(Result.SceneOrigin);
 
-		for (uint32 z = 0; z < Model->size_z; z++)
+
+		for (int32 z = 0; z < Model.Dimensions.Z; z++)
 		{
-			for (uint32 y = 0; y < Model->size_y; y++)
+			for (int32 y = 0; y < Model.Dimensions.Y; y++)
 			{
-				for (uint32 x = 0; x < Model->size_x; x++)
+				for (int32 x = 0; x < Model.Dimensions.X; x++)
 				{
-					const uint8_t VoxelValue = Model->voxel_data[x + y * Model->size_x + z * Model->size_x * Model->
-						size_y];
+					const uint8 VoxelValue = Model.ColorIndices[x + y * Model.Dimensions.X + z * Model.Dimensions.X *
+						Model.Dimensions.Y];
 					if (VoxelValue != 0)
 					{
 						FVector LocalPos(x, y, z);
-						FVector RotatedPos = RotationMatrix.TransformVector(LocalPos);
+						FVector RotatedPos = Instance.Transform.TransformVector(LocalPos);
 
 						const int32 DestX = FMath::FloorToInt(Position.X + RotatedPos.X);
 						const int32 DestY = FMath::FloorToInt(Position.Y + RotatedPos.Y);
 						const int32 DestZ = FMath::FloorToInt(Position.Z + RotatedPos.Z);
 
-						if (DestX >= 0 && DestX < ModelDimensions.X &&
-							DestY >= 0 && DestY < ModelDimensions.Y &&
-							DestZ >= 0 && DestZ < ModelDimensions.Z)
+						if (DestX >= 0 && DestX < Dimensions.X &&
+							DestY >= 0 && DestY < Dimensions.Y &&
+							DestZ >= 0 && DestZ < Dimensions.Z)
 						{
-							const int32 Index = DestX + DestY * ModelDimensions.X + DestZ * ModelDimensions.X *
-								ModelDimensions.Y;
-							VoxelData[Index] = EBlock::Stone;
+							const int32 Index = DestX + DestY * Dimensions.X + DestZ * Dimensions.X *
+								Dimensions.Y;
+							Voxels[Index] = EBlock::Stone;
 						}
 					}
 				}
@@ -101,7 +250,6 @@ bool UVoxImporter::LoadVoxFile(const FString& FilePath)
 		}
 	}
 
-	ogt_vox_destroy_scene(Scene);
 	return true;
 }
 
@@ -111,6 +259,11 @@ TArray<EBlock> UVoxImporter::GetVoxelData() const
 	return VoxelData;
 }
 
+TArray<EBlock> UVoxImporter::TakeVoxelData()
+{
+	return MoveTemp(VoxelData);
+}
+
 FIntVector UVoxImporter::GetModelSize() const
 {
 	return ModelDimensions;
@@ -0,0 +1,71 @@
+#include "VoxLightVolume.h"
+
+void FVoxLightVolume::Init(const FIntVector& InDimensions, uint8 Value)
+{
+	Dimensions = InDimensions;
+	BrickCount = VoxelBrick::GetBrickCount(InDimensions);
+
+	Bricks.Reset();
+	Bricks.SetNum(BrickCount.X * BrickCount.Y * BrickCount.Z);
+
+	for (FBrick& Brick : Bricks)
+	{
+		Brick.Uniform = Value;
+	}
+
+	NumAllocated = 0;
+}
+
+void FVoxLightVolume::Set(const FIntVector& Index, uint8 Value)
+{
+	FBrick& Brick = Bricks[GetBrickIndex(Index)];
+
+	if (!Brick.Voxels)
+	{
+		if (Brick.Uniform == Value)
+			return;
+
+		Brick.Voxels = MakeUniqueForOverwrite<uint8[]>(VoxelBrick::NumVoxels);
+		FMemory::Memset(Brick.Voxels.Get(), Brick.Uniform, VoxelBrick::NumVoxels);
+		NumAllocated++;
+	}
+
+	Brick.Voxels[GetLocalIndex(Index)] = Value;
+}
+
+void FVoxLightVolume::Compact()
+{
+	for (FBrick& Brick : Bricks)
+	{
+		if (!Brick.Voxels)
+			continue;
+
+		const uint8 First = Brick.Voxels[0];
+		bool bUniform = true;
+
+		for (int32 i = 1; i < VoxelBrick::NumVoxels && bUniform; i++)
+		{
+			bUniform = Brick.Voxels[i] == First;
+		}
+
+		if (bUniform)
+		{
+			Brick.Voxels.Reset();
+			Brick.Uniform = First;
+			NumAllocated--;
+		}
+	}
+}
+
+SIZE_T FVoxLightVolume::GetAllocatedSize() const
+{
+	return Bricks.GetAllocatedSize() + static_cast<SIZE_T>(NumAllocated) * VoxelBrick::NumVoxels;
+}
+
+void FVoxLightVolume::Reset()
+{
+	Bricks.Empty();
+	Dimensions = FIntVector::ZeroValue;
+	BrickCount = FIntVector::ZeroValue;
+	NumAllocated = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelBrick.h"
+
+/**
+ * Packed light of a chunk in bricks. Most bricks are all open sky or all dark, they are kept as a single value
+ * and only get voxels of their own once a write makes them differ. Compact gives the voxels back once a brick
+ * is uniform again. Game thread only, mesh jobs copy what they read.
+ */
+class FVoxLightVolume
+{
+public:
+	// Every brick uniform
+	void Init(const FIntVector& InDimensions, uint8 Value);
+
+	bool IsEmpty() const { return Bricks.IsEmpty(); }
+
+	bool IsInBounds(const FIntVector& Index) const
+	{
+		return Index.X >= 0 && Index.Y >= 0 && Index.Z >= 0 && Index.X < Dimensions.X && Index.Y < Dimensions.Y &&
+			Index.Z < Dimensions.Z;
+	}
+
+	// Index has to be in bounds
+	uint8 Get(const FIntVector& Index) const
+	{
+		const FBrick& Brick = Bricks[GetBrickIndex(Index)];
+		return Brick.Voxels ? Brick.Voxels[GetLocalIndex(Index)] : Brick.Uniform;
+	}
+
+	void Set(const FIntVector& Index, uint8 Value);
+
+	// Frees the voxels of bricks that hold a single value
+	void Compact();
+
+	SIZE_T GetAllocatedSize() const;
+
+	void Reset();
+
+private:
+	struct FBrick
+	{
+		// Null while the brick is uniform
+		TUniquePtr<uint8[]> Voxels;
+		uint8 Uniform = 0;
+	};
+
+	int32 GetBrickIndex(const FIntVector& Index) const
+	{
+		return VoxelBrick::GetBrickIndex(
+			FIntVector(Index.X / VoxelBrick::Size, Index.Y / VoxelBrick::Size, Index.Z / VoxelBrick::Size), BrickCount);
+	}
+
+	static int32 GetLocalIndex(const FIntVector& Index)
+	{
+		return VoxelBrick::GetLocalIndex(Index.X % VoxelBrick::Size, Index.Y % VoxelBrick::Size,
+		                                 Index.Z % VoxelBrick::Size);
+	}
+
+	FIntVector Dimensions = FIntVector::ZeroValue;
+	FIntVector BrickCount = FIntVector::ZeroValue;
+	TArray<FBrick> Bricks;
+	int32 NumAllocated = 0;
+};
@@ -0,0 +1,119 @@
+#include "VoxMemory.h"
+#include "ChunkWorld.h"
+#include "MeshApplySubsystem.h"
+#include "MeshCache.h"
+#include "MeshScratch.h"
+#include "VoxModel.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "RealtimeMeshSimple.h"
+
+LLM_DEFINE_TAG(Voxel);
+LLM_DEFINE_TAG(Voxel_Blocks);
+LLM_DEFINE_TAG(Voxel_Brightness);
+LLM_DEFINE_TAG(Voxel_MeshData);
+LLM_DEFINE_TAG(Voxel_MeshStreams);
+LLM_DEFINE_TAG(Voxel_Collision);
+
+void VoxMemory::AddMeshUsage(const URealtimeMesh* Mesh, FVoxMemoryUsage& InOutUsage, FVoxMemoryCounted& Counted)
+{
+	if (!Mesh)
+		return;
+
+	bool bAlreadyCounted = false;
+	Counted.Meshes.Add(Mesh, &bAlreadyCounted);
+
+	if (bAlreadyCounted)
+		return;
+
+	if (const URealtimeMeshSimple* Simple = Cast<const URealtimeMeshSimple>(Mesh))
+	{
+		for (const FRealtimeMeshSectionGroupKey& GroupKey : Simple->GetSectionGroups(FRealtimeMeshLODKey(0)))
+		{
+			Simple->ProcessMesh(GroupKey, [&InOutUsage](const RealtimeMesh::FRealtimeMeshStreamSet& Streams)
+			{
+				Streams.ForEach([&InOutUsage](const RealtimeMesh::FRealtimeMeshStream& Stream)
+				{
+					InOutUsage.MeshCPU += Stream.GetAllocatedSize();
+					InOutUsage.GPU += Stream.GetResourceDataSize();
+				});
+			});
+		}
+	}
+
+	if (UBodySetup* BodySetup = Mesh->GetBodySetup())
+	{
+		InOutUsage.Collision += BodySetup->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	}
+}
+
+void VoxMemory::LogUsage(const FString& Name, const FVoxMemoryUsage& Usage)
+{
+	UE_LOG(LogTemp, Display, TEXT("%s: %.1f KB total, voxels %.1f KB, mesh %.1f KB, GPU %.1f KB, collision %.1f KB"),
+	       *Name, Usage.GetTotal() / 1024.0, Usage.Voxels / 1024.0, Usage.MeshCPU / 1024.0, Usage.GPU / 1024.0,
+	       Usage.Collision / 1024.0);
+}
+
+static FAutoConsoleCommandWithWorld CmdMemReport(
+	TEXT("vox.MemReport"),
+	TEXT("Logs voxel, mesh, GPU and collision bytes of every chunk and vox model, largest first, then the mesh caches and idle scratches, with totals."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+			return;
+
+		FVoxMemoryUsage Total;
+		FVoxMemoryCounted Counted;
+
+		for (TActorIterator<AChunkWorld> It(World); It; ++It)
+		{
+			Total += It->LogMemoryReport(Counted);
+		}
+
+		TArray<TPair<const AVoxModel*, FVoxMemoryUsage>> Models;
+
+		for (TActorIterator<AVoxModel> It(World); It; ++It)
+		{
+			Models.Emplace(*It, It->GetMemoryUsage(Counted));
+		}
+
+		Models.Sort([](const TPair<const AVoxModel*, FVoxMemoryUsage>& A,
+		               const TPair<const AVoxModel*, FVoxMemoryUsage>& B)
+		{
+			return A.Value.GetTotal() > B.Value.GetTotal();
+		});
+
+		FVoxMemoryUsage ModelTotal;
+
+		for (const TPair<const AVoxModel*, FVoxMemoryUsage>& Model : Models)
+		{
+			VoxMemory::LogUsage(FString::Printf(TEXT("Model %s"), *Model.Key->GetName()), Model.Value);
+			ModelTotal += Model.Value;
+		}
+
+		VoxMemory::LogUsage(FString::Printf(TEXT("%d models"), Models.Num()), ModelTotal);
+		Total += ModelTotal;
+
+		if (const UMeshApplySubsystem* Apply = World->GetSubsystem<UMeshApplySubsystem>())
+		{
+			UE_LOG(LogTemp, Display, TEXT("%d finished meshes waiting to be applied: %.1f KB"), Apply->GetNumPending(),
+			       Apply->GetPendingBytes() / 1024.0);
+			Total.MeshCPU += Apply->GetPendingBytes();
+		}
+
+		// Only entries no chunk or model shows anymore are new here
+		const SIZE_T ChunkCacheBytes = VoxMeshCache::Chunks().GetAllocatedSize(Counted.MeshData);
+		UE_LOG(LogTemp, Display, TEXT("Chunk mesh cache: %.1f KB"), ChunkCacheBytes / 1024.0);
+		Total.MeshCPU += ChunkCacheBytes;
+
+		const SIZE_T ModelCacheBytes = VoxMeshCache::Models().GetAllocatedSize(Counted.MeshData);
+		UE_LOG(LogTemp, Display, TEXT("Model mesh cache: %.1f KB"), ModelCacheBytes / 1024.0);
+		Total.MeshCPU += ModelCacheBytes;
+
+		const SIZE_T ScratchBytes = FMeshScratchScope::GetPooledBytes();
+		UE_LOG(LogTemp, Display, TEXT("Idle mesh scratches: %.1f KB"), ScratchBytes / 1024.0);
+		Total.MeshCPU += ScratchBytes;
+
+		VoxMemory::LogUsage(TEXT("Total"), Total);
+	}));
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+class URealtimeMesh;
+
+// LowLevelMemTracker tags, listed under Voxel by stat LLMFULL and memreport -llm. GPU buffers are created by
+// the render thread outside these scopes, vox.MemReport estimates them from the uploaded streams instead.
+LLM_DECLARE_TAG(Voxel);
+LLM_DECLARE_TAG(Voxel_Blocks);
+LLM_DECLARE_TAG(Voxel_Brightness);
+LLM_DECLARE_TAG(Voxel_MeshData);
+LLM_DECLARE_TAG(Voxel_MeshStreams);
+LLM_DECLARE_TAG(Voxel_Collision);
+
+// Bytes held by one chunk, model or world, see vox.MemReport
+struct FVoxMemoryUsage
+{
+	// Blocks, columns and light
+	SIZE_T Voxels = 0;
+
+	// Kept mesh data and the stream copies of the realtime meshes
+	SIZE_T MeshCPU = 0;
+
+	// Vertex and index buffers uploaded from the streams
+	SIZE_T GPU = 0;
+
+	// Collision boxes and cooked collision
+	SIZE_T Collision = 0;
+
+	SIZE_T GetTotal() const { return Voxels + MeshCPU + GPU + Collision; }
+
+	FVoxMemoryUsage& operator+=(const FVoxMemoryUsage& Other)
+	{
+		Voxels += Other.Voxels;
+		MeshCPU += Other.MeshCPU;
+		GPU += Other.GPU;
+		Collision += Other.Collision;
+		return *this;
+	}
+};
+
+// Meshes, mesh data and brick allocations already reported, anything shared between actors and caches is only
+// counted once
+struct FVoxMemoryCounted
+{
+	TSet<const URealtimeMesh*> Meshes;
+	TSet<const void*> MeshData;
+	TSet<const void*> Bricks;
+};
+
+namespace VoxMemory
+{
+	// Streams of every section group and the body setup of the mesh, skipped if it was already counted
+	void AddMeshUsage(const URealtimeMesh* Mesh, FVoxMemoryUsage& InOutUsage, FVoxMemoryCounted& Counted);
+
+	void LogUsage(const FString& Name, const FVoxMemoryUsage& Usage);
+}
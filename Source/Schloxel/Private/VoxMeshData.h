@@ -14,4 +14,10 @@ struct FVoxMeshData
 	TArray<int> Triangles;
 	TArray<FVector> Normals;
 	TArray<FVector2D> UV0;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Vertices.GetAllocatedSize() + Triangles.GetAllocatedSize() + Normals.GetAllocatedSize() +
+			UV0.GetAllocatedSize();
+	}
 };
\ No newline at end of file
@@ -1,8 +1,50 @@
 #include "VoxModel.h"
 
 #include "AVoxMeshThread.h"
+#include "VoxAsset.h"
+#include "VoxExporter.h"
 #include "VoxImporter.h"
+#include "VoxModelSubsystem.h"
+#include "VoxMemory.h"
+#include "Engine/AssetManager.h"
 #include "RealtimeMeshSimple.h"
+#include "Async/Async.h"
+
+static void BuildVoxMesh(URealtimeMeshSimple* RealtimeMesh, const FVoxMeshData& Data, UMaterialInterface* Material)
+{
+	LLM_SCOPE_BYTAG(Voxel_MeshStreams);
+
+	RealtimeMesh::FRealtimeMeshStreamSet StreamSet;
+	RealtimeMesh::TRealtimeMeshBuilderLocal<uint32, FPackedNormal, FVector2DHalf, 1> Builder(StreamSet);
+
+	Builder.EnableTangents();
+	Builder.EnableTexCoords();
+	Builder.EnableColors();
+	Builder.EnablePolyGroups();
+
+	for (int i = 0; i < Data.Vertices.Num(); i++)
+	{
+		int32 VertexIndex = Builder.AddVertex(FVector3f(Data.Vertices[i]))
+		                           .SetNormalAndTangent(FVector3f(Data.Normals[i]),
+		                                                FVector3f(0, 0, 0))
+		                           .SetTexCoord(FVector2f(Data.UV0[i]));
+	}
+
+	for (int32 i = 0; i < Data.Triangles.Num(); i += 3)
+	{
+		Builder.AddTriangle(Data.Triangles[i], Data.Triangles[i + 1], Data.Triangles[i + 2], 0);
+	}
+
+	RealtimeMesh->SetupMaterialSlot(0, "PrimaryMaterial", Material);
+
+	const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(
+		0, FName("VoxMesh"));
+	const FRealtimeMeshSectionKey SectionKey = FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, 0);
+
+	RealtimeMesh->CreateSectionGroup(GroupKey, StreamSet,
+	                                 FRealtimeMeshSectionGroupConfig(ERealtimeMeshSectionDrawType::Static));
+	RealtimeMesh->UpdateSectionConfig(SectionKey, FRealtimeMeshSectionConfig(0), true);
+}
 
 AVoxModel::AVoxModel()
 {
@@ -32,31 +74,289 @@ void AVoxModel::BeginPlay()
 	LoadVoxModel();
 }
 
+void AVoxModel::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelPendingImport();
+	UVoxModelSubsystem::ReleaseModel(this, SharedModel);
+	Super::EndPlay(EndPlayReason);
+}
+
+void AVoxModel::BeginDestroy()
+{
+	CancelPendingImport();
+	UVoxModelSubsystem::ReleaseModel(this, SharedModel);
+	Super::BeginDestroy();
+}
+
 void AVoxModel::LoadVoxModel()
 {
-	if (!VoxFilePath.IsEmpty())
+	CancelPendingImport();
+
+	// Acquired before releasing so a reconstructed actor keeps an already loaded model
+	TSharedPtr<FVoxSharedModel> PreviousModel = MoveTemp(SharedModel);
+
+	UVoxModelSubsystem* Subsystem = GetWorld() ? GetWorld()->GetSubsystem<UVoxModelSubsystem>() : nullptr;
+	if (!bInstanceModels && Subsystem && (!VoxAsset.IsNull() || !VoxFilePath.IsEmpty()))
 	{
-		UVoxImporter* Importer = NewObject<UVoxImporter>();
-		if (Importer->LoadVoxFile(VoxFilePath))
+		SharedModel = Subsystem->AcquireModel(this);
+		if (SharedModel->IsLoaded())
 		{
-			ModelDimensions = Importer->GetModelSize();
-			Blocks = Importer->GetVoxelData();
-			GenerateMesh();
+			AdoptSharedModel(false);
 		}
 	}
+
+	if (PreviousModel != SharedModel)
+	{
+		UVoxModelSubsystem::ReleaseModel(this, PreviousModel);
+	}
+
+	if (SharedModel.IsValid())
+		return;
+
+	const TSharedRef<FVoxImportState> ImportState = MakeShared<FVoxImportState>();
+
+	if (!VoxAsset.IsNull())
+	{
+		PendingImport = ImportState;
+
+		// The asset comes in through the async loader, its bricks are streamed separately afterwards
+		UAssetManager::GetStreamableManager().RequestAsyncLoad(
+			VoxAsset.ToSoftObjectPath(),
+			FStreamableDelegate::CreateWeakLambda(this, [this, ImportState]()
+			{
+				const UVoxAsset* Asset = VoxAsset.Get();
+				if (!Asset || ImportState->IsCancelled())
+					return;
+
+				FinishImport(Asset->LoadVoxelDataAsync(ImportState, !bInstanceModels), ImportState);
+			}));
+		return;
+	}
+
+	if (VoxFilePath.IsEmpty())
+		return;
+
+	PendingImport = ImportState;
+	FinishImport(UVoxImporter::LoadVoxFileAsync(VoxFilePath, ImportState, !bInstanceModels), ImportState);
+}
+
+void AVoxModel::FinishImport(TFuture<FVoxImportResult>&& Import, const TSharedRef<FVoxImportState>& ImportState)
+{
+	Import.Next([WeakThis = TWeakObjectPtr<AVoxModel>(this), ImportState](FVoxImportResult Result)
+	{
+		if (!Result.bSuccess || ImportState->IsCancelled())
+			return;
+
+		// Actors may only be touched on the game thread, the grid is moved over rather than copied
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, ImportState, Result = MoveTemp(Result)]() mutable
+		{
+			AVoxModel* VoxModel = WeakThis.Get();
+			if (!VoxModel || ImportState->IsCancelled() || VoxModel->PendingImport.Get() != &ImportState.Get())
+				return;
+
+			VoxModel->PendingImport.Reset();
+			VoxModel->ModelDimensions = Result.ModelDimensions;
+			VoxModel->bEdited = false;
+
+			if (VoxModel->bInstanceModels)
+			{
+				VoxModel->InstancedScene = MoveTemp(Result);
+				VoxModel->SpawnInstanceComponents();
+			}
+			else
+			{
+				VoxModel->Blocks = FVoxBlockVolume(Result.ModelDimensions, Result.VoxelData);
+			}
+
+			VoxModel->GenerateMesh();
+		});
+	});
+}
+
+void AVoxModel::CancelPendingImport()
+{
+	if (PendingImport.IsValid())
+	{
+		PendingImport->Cancel();
+		PendingImport.Reset();
+	}
+}
+
+void AVoxModel::AdoptSharedModel(bool bGenerateMesh)
+{
+	ModelDimensions = SharedModel->ModelDimensions;
+	Blocks = SharedModel->Blocks;
+	bEdited = false;
+
+	if (SharedModel->Mesh.IsValid())
+	{
+		MeshComponent->SetRealtimeMesh(SharedModel->Mesh.Get());
+	}
+	else if (bGenerateMesh)
+	{
+		GenerateMesh();
+	}
+}
+
+bool AVoxModel::IsImporting() const
+{
+	if (HasImportFailed())
+		return false;
+
+	return PendingImport.IsValid() || (SharedModel.IsValid() && !SharedModel->IsLoaded());
+}
+
+bool AVoxModel::HasImportFailed() const
+{
+	if (PendingImport.IsValid())
+	{
+		return PendingImport->HasFailed();
+	}
+
+	return SharedModel.IsValid() && !SharedModel->IsLoaded() && SharedModel->ImportState.IsValid() &&
+		SharedModel->ImportState->HasFailed();
+}
+
+float AVoxModel::GetImportProgress() const
+{
+	if (PendingImport.IsValid())
+	{
+		return PendingImport->Progress;
+	}
+
+	if (SharedModel.IsValid() && !SharedModel->IsLoaded())
+	{
+		return SharedModel->ImportState.IsValid() ? SharedModel->ImportState->Progress.load() : 0.0f;
+	}
+
+	return !Blocks.IsEmpty() || InstancedScene.Models.Num() > 0 ? 1.0f : 0.0f;
+}
+
+void AVoxModel::ExportVoxFile(const FString& FilePath)
+{
+	ExportVoxFileAsync(FilePath, MakeShared<FVoxImportState>()).Next([FilePath](bool bSaved)
+	{
+		if (bSaved)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Exported vox model to %s"), *FilePath);
+		}
+	});
+}
+
+TFuture<bool> AVoxModel::ExportVoxFileAsync(const FString& FilePath, const TSharedRef<FVoxImportState>& State)
+{
+	check(IsInGameThread());
+
+	if (!Blocks.IsEmpty() || InstancedScene.Models.IsEmpty())
+	{
+		return FVoxExporter::SaveVoxFileAsync(FilePath, Blocks, State);
+	}
+
+	// Unedited instanced scenes have no grid yet, flatten a copy off the game thread
+	return Async(EAsyncExecution::ThreadPool, [FilePath, Scene = InstancedScene, State]() mutable
+	{
+		const bool bSaved = UVoxImporter::FlattenScene(Scene, &State.Get()) &&
+			FVoxExporter::SaveVoxFile(FilePath, FVoxBlockVolume(Scene.ModelDimensions, Scene.VoxelData), &State.Get());
+		State->Finish(bSaved);
+		return bSaved;
+	});
 }
 
 void AVoxModel::GenerateMesh()
 {
-	new AVoxMeshThread(this);
+	++MeshRevision;
+
+	if (InstancedScene.Models.IsEmpty())
+	{
+		AVoxMeshThread::Launch(this, MeshRevision);
+		return;
+	}
+
+	for (int32 ModelIndex = 0; ModelIndex < InstancedScene.Models.Num(); ModelIndex++)
+	{
+		AVoxMeshThread::Launch(this, MeshRevision, ModelIndex);
+	}
+}
+
+void AVoxModel::SpawnInstanceComponents()
+{
+	const TArray<FVoxSceneInstance>& Instances = InstancedScene.SceneGraph.Instances;
+
+	ModelMeshes.SetNum(InstancedScene.Models.Num());
+	InstanceComponents.SetNum(Instances.Num());
+
+	for (int32 i = 0; i < Instances.Num(); i++)
+	{
+		if (Instances[i].bHidden || !InstancedScene.Models.IsValidIndex(Instances[i].ModelIndex))
+			continue;
+
+		URealtimeMeshComponent* Component = NewObject<URealtimeMeshComponent>(this, NAME_None, RF_Transient);
+		Component->SetMobility(EComponentMobility::Static);
+		Component->SetCastShadow(true);
+		Component->SetupAttachment(MeshComponent);
+		Component->SetRelativeTransform(GetInstanceTransform(Instances[i]));
+
+		Component->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+		Component->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		Component->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Block);
+
+		Component->RegisterComponent();
+		InstanceComponents[i] = Component;
+	}
+}
+
+void AVoxModel::ClearInstances()
+{
+	for (URealtimeMeshComponent* Component : InstanceComponents)
+	{
+		if (Component)
+		{
+			Component->DestroyComponent();
+		}
+	}
+
+	InstanceComponents.Empty();
+	ModelMeshes.Empty();
+	InstancedScene = FVoxImportResult();
+}
+
+FTransform AVoxModel::GetInstanceTransform(const FVoxSceneInstance& Instance) const
+{
+	const FMatrix& Transform = Instance.Transform;
+
+	// Mirrored axes turn a voxel's min corner into its max corner, FlattenScene places the cell one step further
+	const FVector Axes = Transform.TransformVector(FVector::OneVector);
+	const FVector CellOffset(FMath::Max(0.0, -Axes.X), FMath::Max(0.0, -Axes.Y), FMath::Max(0.0, -Axes.Z));
+
+	const FVector CenterOffset(-ModelDimensions.X * VoxelSize * 0.5f, -ModelDimensions.Y * VoxelSize * 0.5f, 0.0f);
+	const FVector Translation = (Transform.GetOrigin() - FVector(InstancedScene.SceneOrigin) + CellOffset) * VoxelSize +
+		CenterOffset;
+
+	FMatrix Matrix = Transform;
+	Matrix.SetOrigin(Translation);
+	return FTransform(Matrix);
 }
 
 void AVoxModel::ModifyVoxel(const FIntVector Position, const EBlock Block)
 {
+	LLM_SCOPE_BYTAG(Voxel_Blocks);
+
 	if (Position.X >= ModelDimensions.X || Position.Y >= ModelDimensions.Y ||
 		Position.Z >= ModelDimensions.Z || Position.X < 0 || Position.Y < 0 || Position.Z < 0)
 		return;
 
+	// Instances can't be edited independently, bake the scene into one grid once
+	if (!InstancedScene.Models.IsEmpty())
+	{
+		UVoxImporter::FlattenScene(InstancedScene, nullptr);
+		Blocks = FVoxBlockVolume(ModelDimensions, InstancedScene.VoxelData);
+		ClearInstances();
+	}
+
+	// The shared grid is never written, this actor diverges from it brick by brick
+	UVoxModelSubsystem::ReleaseModel(this, SharedModel);
+	bEdited = true;
+
 	constexpr int Radius = 8;
 
 	for (int x = -Radius + 1; x <= Radius - 1; ++x)
@@ -74,11 +374,7 @@ void AVoxModel::ModifyVoxel(const FIntVector Position, const EBlock Block)
 				float distance = FVector::Dist(FVector(x, y, z), FVector::ZeroVector);
 				if (distance <= Radius)
 				{
-					const int index = CurrentPos.X + CurrentPos.Y * ModelDimensions.X +
-						CurrentPos.Z * (ModelDimensions.X * ModelDimensions.Y);
-
-					if (index >= 0 && index < Blocks.Num())
-						Blocks[index] = Block;
+					Blocks.Set(CurrentPos.X, CurrentPos.Y, CurrentPos.Z, Block);
 				}
 			}
 		}
@@ -88,57 +384,72 @@ void AVoxModel::ModifyVoxel(const FIntVector Position, const EBlock Block)
 }
 
 
-void AVoxModel::ApplyMesh()
+void AVoxModel::ApplyMesh(const FVoxMeshData& Data, int32 ModelIndex, const TWeakPtr<FVoxSharedModel>& Shared,
+                          uint32 Revision)
 {
-	AsyncTask(ENamedThreads::GameThread, [this]()
+	if (Revision < AppliedMeshRevision)
+		return;
+
+	AppliedMeshRevision = Revision;
+
+	if (ModelIndex == INDEX_NONE)
 	{
-		while (!MeshDataQueue.IsEmpty())
+		// Every actor still on the shared grid gets the same mesh
+		if (const TSharedPtr<FVoxSharedModel> SharedGrid = Shared.Pin())
 		{
-			TQueue<FVoxMeshData>::FElementType data;
-			if (MeshDataQueue.Dequeue(data))
-			{
-				URealtimeMeshSimple* RealtimeMesh = MeshComponent->InitializeRealtimeMesh<URealtimeMeshSimple>();
+			URealtimeMeshSimple* SharedMesh = NewObject<URealtimeMeshSimple>(
+				GetTransientPackage(), NAME_None, RF_Transient);
+			BuildVoxMesh(SharedMesh, Data, Material);
+			SharedGrid->SetMesh(SharedMesh);
+			return;
+		}
 
-				RealtimeMesh::FRealtimeMeshStreamSet StreamSet;
-				RealtimeMesh::TRealtimeMeshBuilderLocal<uint32, FPackedNormal, FVector2DHalf, 1> Builder(StreamSet);
+		BuildVoxMesh(MeshComponent->InitializeRealtimeMesh<URealtimeMeshSimple>(), Data, Material);
+		return;
+	}
 
-				Builder.EnableTangents();
-				Builder.EnableTexCoords();
-				Builder.EnableColors();
-				Builder.EnablePolyGroups();
+	// The scene may have been flattened or reloaded since the job started
+	if (!ModelMeshes.IsValidIndex(ModelIndex))
+		return;
 
-				for (int i = 0; i < data.Vertices.Num(); i++)
-				{
-					int32 VertexIndex = Builder.AddVertex(FVector3f(data.Vertices[i]))
-					                           .SetNormalAndTangent(FVector3f(data.Normals[i]),
-					                                                FVector3f(0, 0, 0))
-					                           .SetTexCoord(FVector2f(data.UV0[i]));
-				}
+	URealtimeMeshSimple* ModelMesh = NewObject<URealtimeMeshSimple>(this, NAME_None, RF_Transient);
+	BuildVoxMesh(ModelMesh, Data, Material);
+	ModelMeshes[ModelIndex] = ModelMesh;
 
-				for (int32 i = 0; i < data.Triangles.Num(); i += 3)
-				{
-					Builder.AddTriangle(data.Triangles[i], data.Triangles[i + 1], data.Triangles[i + 2], 0);
-				}
+	const TArray<FVoxSceneInstance>& Instances = InstancedScene.SceneGraph.Instances;
+	for (int32 i = 0; i < Instances.Num(); i++)
+	{
+		if (Instances[i].ModelIndex == ModelIndex && InstanceComponents[i])
+		{
+			InstanceComponents[i]->SetRealtimeMesh(ModelMesh);
+		}
+	}
+}
 
-				RealtimeMesh->SetupMaterialSlot(0, "PrimaryMaterial", Material);
 
-				const FRealtimeMeshSectionGroupKey GroupKey = FRealtimeMeshSectionGroupKey::Create(
-					0, FName("VoxMesh"));
-				const FRealtimeMeshSectionKey SectionKey = FRealtimeMeshSectionKey::CreateForPolyGroup(GroupKey, 0);
+FVoxMemoryUsage AVoxModel::GetMemoryUsage(FVoxMemoryCounted& Counted) const
+{
+	FVoxMemoryUsage Usage;
+	Usage.Voxels = Blocks.GetAllocatedSize(Counted.Bricks);
 
-				RealtimeMesh->CreateSectionGroup(GroupKey, StreamSet,
-				                                 FRealtimeMeshSectionGroupConfig(ERealtimeMeshSectionDrawType::Static));
-				RealtimeMesh->UpdateSectionConfig(SectionKey, FRealtimeMeshSectionConfig(0), true);
-			}
-		}
-	});
-}
+	if (SharedModel)
+	{
+		Usage.Voxels += SharedModel->Blocks.GetAllocatedSize(Counted.Bricks);
+	}
+
+	VoxMemory::AddMeshUsage(MeshComponent->GetRealtimeMesh(), Usage, Counted);
 
+	for (const URealtimeMeshSimple* ModelMesh : ModelMeshes)
+	{
+		VoxMemory::AddMeshUsage(ModelMesh, Usage, Counted);
+	}
+
+	return Usage;
+}
 
 void AVoxModel::ClearMeshData()
 {
-	Blocks.Empty();
+	ClearInstances();
+	Blocks.Reset();
 	ModelDimensions = FIntVector::ZeroValue;
-
-	MeshDataQueue.Empty();
 }
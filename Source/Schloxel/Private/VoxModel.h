@@ -6,8 +6,16 @@
 #include "Enums.h"
 #include "RealtimeMeshComponent.h"
 #include "VoxMeshData.h"
+#include "VoxImporter.h"
+#include "VoxBlockVolume.h"
 #include "VoxModel.generated.h"
 
+struct FVoxSharedModel;
+struct FVoxMemoryUsage;
+struct FVoxMemoryCounted;
+class UVoxAsset;
+class URealtimeMeshSimple;
+
 UCLASS(MinimalAPI)
 class AVoxModel : public AActor
 {
@@ -20,6 +28,25 @@ public:
 	UFUNCTION(BlueprintCallable, Category="Vox Model")
 	void ModifyVoxel(const FIntVector Position, const EBlock Block);
 
+	// Progress of the running .vox import in 0..1, 1 once the model is loaded. A failed import stays where
+	// it stopped, see HasImportFailed.
+	UFUNCTION(BlueprintPure, Category="Vox Model")
+	float GetImportProgress() const;
+
+	UFUNCTION(BlueprintPure, Category="Vox Model")
+	bool IsImporting() const;
+
+	// The last import couldn't be read or was cancelled, the model keeps what it had before
+	UFUNCTION(BlueprintPure, Category="Vox Model")
+	bool HasImportFailed() const;
+
+	// Writes the current, possibly edited grid to a .vox file in the background
+	UFUNCTION(BlueprintCallable, Category="Vox Model")
+	void ExportVoxFile(const FString& FilePath);
+
+	// Snapshots the grid on the game thread, everything else happens on the thread pool
+	TFuture<bool> ExportVoxFileAsync(const FString& FilePath, const TSharedRef<FVoxImportState>& State);
+
 	FIntVector WorldToModelPosition(const FVector& WorldPosition) const
 	{
 		FVector LocalPosition = WorldPosition - GetActorLocation();
@@ -35,12 +62,20 @@ public:
 	}
 
 
+	// Cooked model, preferred over VoxFilePath when set
+	UPROPERTY(EditAnywhere, Category="Vox Model")
+	TSoftObjectPtr<UVoxAsset> VoxAsset;
+
 	UPROPERTY(EditAnywhere, Category="Vox Model")
 	FString VoxFilePath;
 
 	UPROPERTY(EditAnywhere, Category="Vox Model")
 	float VoxelSize = 10.0f;
 
+	// Mesh every unique model once and place it per instance. The scene is flattened on the first edit.
+	UPROPERTY(EditAnywhere, Category="Vox Model")
+	bool bInstanceModels = false;
+
 	UPROPERTY()
 	TObjectPtr<URealtimeMeshComponent> MeshComponent;
 
@@ -49,17 +84,57 @@ public:
 
 	FIntVector ModelDimensions;
 
-	TQueue<FVoxMeshData> MeshDataQueue;
+	// Shares its bricks with the other actors of the same source until edited
+	FVoxBlockVolume Blocks;
 
-	TArray<EBlock> Blocks;
+	// Set by ModifyVoxel until the grid is loaded again, meshes of edited grids aren't cached
+	bool bEdited = false;
 
-	void ApplyMesh();
+	// Source this actor shares its grid and mesh with, reset on the first edit
+	TSharedPtr<FVoxSharedModel> SharedModel;
+
+	// Unique models and scene graph while bInstanceModels is active and nothing was edited
+	FVoxImportResult InstancedScene;
+
+	// Game thread only, called by UMeshApplySubsystem. Results of an older GenerateMesh than the newest applied
+	// one are dropped. ModelIndex is the unique model the mesh belongs to, INDEX_NONE for the flattened grid.
+	// Shared is set when the grid was meshed on behalf of every actor sharing it.
+	void ApplyMesh(const FVoxMeshData& Data, int32 ModelIndex, const TWeakPtr<FVoxSharedModel>& Shared,
+	               uint32 Revision);
+
+	// Called by UVoxModelSubsystem once the shared grid is loaded
+	void AdoptSharedModel(bool bGenerateMesh);
+
+	// For vox.MemReport. Bricks and meshes shared with other models are counted by the first one reported.
+	FVoxMemoryUsage GetMemoryUsage(FVoxMemoryCounted& Counted) const;
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void BeginDestroy() override;
 
 private:
 	void GenerateMesh();
 	void LoadVoxModel();
+	void FinishImport(TFuture<FVoxImportResult>&& Import, const TSharedRef<FVoxImportState>& ImportState);
+	void CancelPendingImport();
 	void ClearMeshData();
+
+	void SpawnInstanceComponents();
+	void ClearInstances();
+	FTransform GetInstanceTransform(const FVoxSceneInstance& Instance) const;
+
+	TSharedPtr<FVoxImportState> PendingImport;
+
+	// Bumped by every GenerateMesh, all jobs of one call share it
+	uint32 MeshRevision = 0;
+	uint32 AppliedMeshRevision = 0;
+
+	// One mesh per unique model, shared by all of its instance components
+	UPROPERTY()
+	TArray<TObjectPtr<URealtimeMeshSimple>> ModelMeshes;
+
+	// Parallel to InstancedScene.SceneGraph.Instances, null for hidden instances
+	UPROPERTY()
+	TArray<TObjectPtr<URealtimeMeshComponent>> InstanceComponents;
 };
@@ -0,0 +1,145 @@
+#include "VoxModelSubsystem.h"
+
+#include "VoxAsset.h"
+#include "VoxImporter.h"
+#include "VoxModel.h"
+#include "Async/Async.h"
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+#include "RealtimeMeshSimple.h"
+
+FVoxSharedModel::~FVoxSharedModel()
+{
+	// The last user is gone, nobody is waiting for the import anymore
+	if (ImportState.IsValid())
+	{
+		ImportState->Cancel();
+	}
+}
+
+void FVoxSharedModel::SetMesh(URealtimeMeshSimple* NewMesh)
+{
+	Mesh.Reset(NewMesh);
+
+	for (const TWeakObjectPtr<AVoxModel>& User : Users)
+	{
+		if (User.IsValid())
+		{
+			User->MeshComponent->SetRealtimeMesh(NewMesh);
+		}
+	}
+}
+
+TSharedRef<FVoxSharedModel> UVoxModelSubsystem::AcquireModel(AVoxModel* User)
+{
+	check(IsInGameThread());
+
+	const TSoftObjectPtr<UVoxAsset> Asset = User->VoxAsset;
+	const FString FilePath = User->VoxFilePath;
+
+	// The mesh depends on the voxel size and material as well, not just on the grid
+	const FString Key = FString::Printf(TEXT("%s|%g|%s"),
+	                                    Asset.IsNull() ? *FPaths::ConvertRelativePathToFull(FilePath) : *Asset.ToString(),
+	                                    User->VoxelSize, *GetPathNameSafe(User->Material));
+
+	if (TSharedPtr<FVoxSharedModel> Existing = Models.FindRef(Key).Pin())
+	{
+		Existing->Users.AddUnique(User);
+		return Existing.ToSharedRef();
+	}
+
+	const TSharedRef<FVoxSharedModel> Model = MakeShared<FVoxSharedModel>();
+	Model->Key = Key;
+	Model->Users.Add(User);
+	Models.Add(Key, Model);
+
+	const TSharedRef<FVoxImportState> ImportState = MakeShared<FVoxImportState>();
+	Model->ImportState = ImportState;
+
+	if (Asset.IsNull())
+	{
+		FinishLoad(UVoxImporter::LoadVoxFileAsync(FilePath, ImportState), Model);
+		return Model;
+	}
+
+	// Bound to the model rather than to the actor that happened to request it first
+	UAssetManager::GetStreamableManager().RequestAsyncLoad(
+		Asset.ToSoftObjectPath(),
+		FStreamableDelegate::CreateWeakLambda(this, [this, Asset, WeakModel = Model.ToWeakPtr()]()
+		{
+			const TSharedPtr<FVoxSharedModel> Pinned = WeakModel.Pin();
+			const UVoxAsset* LoadedAsset = Asset.Get();
+			if (!Pinned.IsValid() || !LoadedAsset)
+				return;
+
+			FinishLoad(LoadedAsset->LoadVoxelDataAsync(Pinned->ImportState.ToSharedRef()), Pinned.ToSharedRef());
+		}));
+
+	return Model;
+}
+
+void UVoxModelSubsystem::ReleaseModel(AVoxModel* User, TSharedPtr<FVoxSharedModel>& Model)
+{
+	if (!Model.IsValid())
+		return;
+
+	Model->Users.Remove(User);
+
+	// Its job is dropped or replaced by its own edits, everyone else would wait for the mesh forever
+	if (Model->IsLoaded() && !Model->Mesh.IsValid() && Model->Mesher == User)
+	{
+		Model->Mesher.Reset();
+
+		for (const TWeakObjectPtr<AVoxModel>& Other : TArray<TWeakObjectPtr<AVoxModel>>(Model->Users))
+		{
+			const UWorld* World = Other.IsValid() ? Other->GetWorld() : nullptr;
+			if (World && !World->bIsTearingDown && !Other->IsActorBeingDestroyed())
+			{
+				Model->Mesher = Other;
+				Other->AdoptSharedModel(true);
+				break;
+			}
+		}
+	}
+
+	Model.Reset();
+}
+
+void UVoxModelSubsystem::FinishLoad(TFuture<FVoxImportResult>&& Import, const TSharedRef<FVoxSharedModel>& Model)
+{
+	Import.Next([WeakModel = Model.ToWeakPtr()](FVoxImportResult Result)
+	{
+		if (!Result.bSuccess || !WeakModel.IsValid())
+			return;
+
+		// Bricked here so the game thread only swaps pointers
+		FVoxBlockVolume Blocks(Result.ModelDimensions, Result.VoxelData);
+		Result.VoxelData.Empty();
+
+		AsyncTask(ENamedThreads::GameThread, [WeakModel, Dimensions = Result.ModelDimensions,
+			Blocks = MoveTemp(Blocks)]() mutable
+		{
+			const TSharedPtr<FVoxSharedModel> Pinned = WeakModel.Pin();
+			if (!Pinned.IsValid())
+				return;
+
+			Pinned->ModelDimensions = Dimensions;
+			Pinned->Blocks = MoveTemp(Blocks);
+
+			// One user meshes for everyone
+			for (const TWeakObjectPtr<AVoxModel>& User : TArray<TWeakObjectPtr<AVoxModel>>(Pinned->Users))
+			{
+				if (User.IsValid())
+				{
+					const bool bMesher = !Pinned->Mesher.IsValid();
+					if (bMesher)
+					{
+						Pinned->Mesher = User;
+					}
+
+					User->AdoptSharedModel(bMesher);
+				}
+			}
+		});
+	});
+}
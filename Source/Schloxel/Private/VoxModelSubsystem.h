@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/StrongObjectPtr.h"
+#include "VoxBlockVolume.h"
+#include "VoxModelSubsystem.generated.h"
+
+struct FVoxImportState;
+struct FVoxImportResult;
+class AVoxModel;
+class URealtimeMeshSimple;
+
+// Grid and mesh of one .vox source, shared by every AVoxModel that loaded it and hasn't been edited since
+struct FVoxSharedModel
+{
+	~FVoxSharedModel();
+
+	bool IsLoaded() const { return !Blocks.IsEmpty(); }
+
+	// Game thread only, hands the mesh to every user
+	void SetMesh(URealtimeMeshSimple* NewMesh);
+
+	FString Key;
+	FIntVector ModelDimensions = FIntVector::ZeroValue;
+
+	// Never written once loaded, users copy it and diverge brick by brick
+	FVoxBlockVolume Blocks;
+
+	TStrongObjectPtr<URealtimeMeshSimple> Mesh;
+	TSharedPtr<FVoxImportState> ImportState;
+	TArray<TWeakObjectPtr<AVoxModel>> Users;
+
+	// User whose job meshes the grid for everyone until Mesh is set. Handed to another user if it leaves first.
+	TWeakObjectPtr<AVoxModel> Mesher;
+};
+
+/**
+ * Loads each .vox source once per world. The models stay alive as long as an actor holds them.
+ */
+UCLASS()
+class UVoxModelSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Registers the actor as a user of the source and starts the import if nobody holds it yet. Game thread only.
+	TSharedRef<FVoxSharedModel> AcquireModel(AVoxModel* User);
+
+	// Another user takes over meshing if the released one was still meshing for everyone
+	static void ReleaseModel(AVoxModel* User, TSharedPtr<FVoxSharedModel>& Model);
+
+private:
+	void FinishLoad(TFuture<FVoxImportResult>&& Import, const TSharedRef<FVoxSharedModel>& Model);
+
+	TMap<FString, TWeakPtr<FVoxSharedModel>> Models;
+};
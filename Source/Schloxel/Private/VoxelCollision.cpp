@@ -0,0 +1,330 @@
+#include "VoxelCollision.h"
+#include "ChunkWorld.h"
+
+FVoxelCollision::FVoxelCollision(const AChunkWorld& InWorld)
+	: World(InWorld), VoxelSize(InWorld.GetVoxelSize())
+{
+}
+
+bool FVoxelCollision::IsSolid(const FIntVector& Voxel) const
+{
+	return World.IsSolid(Voxel);
+}
+
+FIntVector FVoxelCollision::GetVoxel(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / VoxelSize), FMath::FloorToInt(Location.Y / VoxelSize),
+	                  FMath::FloorToInt(Location.Z / VoxelSize));
+}
+
+void FVoxelCollision::GetVoxelRange(const FBox& Box, FIntVector& OutMin, FIntVector& OutMax) const
+{
+	for (int Axis = 0; Axis < 3; ++Axis)
+	{
+		OutMin[Axis] = FMath::FloorToInt((Box.Min[Axis] + Skin) / VoxelSize);
+		OutMax[Axis] = FMath::CeilToInt((Box.Max[Axis] - Skin) / VoxelSize) - 1;
+	}
+}
+
+FBox FVoxelCollision::GetVoxelBox(const FIntVector& Voxel) const
+{
+	return FBox(FVector(Voxel) * VoxelSize, FVector(Voxel + FIntVector(1)) * VoxelSize);
+}
+
+double FVoxelCollision::GetCapsuleDistanceSquared(const FVector& Center, float Radius, float HalfHeight,
+                                                 const FBox& Box)
+{
+	// The capsule is a vertical segment grown by the radius
+	const float SegmentHalf = FMath::Max(HalfHeight - Radius, 0.0f);
+
+	const double DX = FMath::Max3(Box.Min.X - Center.X, 0.0, Center.X - Box.Max.X);
+	const double DY = FMath::Max3(Box.Min.Y - Center.Y, 0.0, Center.Y - Box.Max.Y);
+	const double DZ = FMath::Max3(Box.Min.Z - (Center.Z + SegmentHalf), 0.0, (Center.Z - SegmentHalf) - Box.Max.Z);
+
+	return DX * DX + DY * DY + DZ * DZ;
+}
+
+bool FVoxelCollision::OverlapBox(const FBox& Box) const
+{
+	FIntVector Min, Max;
+	GetVoxelRange(Box, Min, Max);
+
+	for (int z = Min.Z; z <= Max.Z; ++z)
+	{
+		for (int y = Min.Y; y <= Max.Y; ++y)
+		{
+			for (int x = Min.X; x <= Max.X; ++x)
+			{
+				if (IsSolid(FIntVector(x, y, z)))
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool FVoxelCollision::OverlapCapsule(const FVector& Center, float Radius, float HalfHeight) const
+{
+	const FVector Extent(Radius, Radius, FMath::Max(HalfHeight, Radius));
+
+	FIntVector Min, Max;
+	GetVoxelRange(FBox(Center - Extent, Center + Extent), Min, Max);
+
+	const double Reach = FMath::Square(FMath::Max(Radius - Skin, 0.0f));
+
+	for (int z = Min.Z; z <= Max.Z; ++z)
+	{
+		for (int y = Min.Y; y <= Max.Y; ++y)
+		{
+			for (int x = Min.X; x <= Max.X; ++x)
+			{
+				const FIntVector Voxel(x, y, z);
+
+				if (IsSolid(Voxel) && GetCapsuleDistanceSquared(Center, Radius, HalfHeight, GetVoxelBox(Voxel)) < Reach)
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+FVoxelCollision::FSweepHit FVoxelCollision::SweepBox(const FBox& Box, const FVector& Delta) const
+{
+	FSweepHit Hit;
+
+	if (Delta.IsNearlyZero())
+		return Hit;
+
+	FIntVector StartMin, StartMax;
+	GetVoxelRange(Box, StartMin, StartMax);
+
+	FIntVector Min, Max;
+	GetVoxelRange((Box + Box.ShiftBy(Delta)).ExpandBy(Skin), Min, Max);
+
+	const FVector Origin = Box.GetCenter();
+	const FVector Extent = Box.GetExtent();
+
+	for (int z = Min.Z; z <= Max.Z; ++z)
+	{
+		for (int y = Min.Y; y <= Max.Y; ++y)
+		{
+			for (int x = Min.X; x <= Max.X; ++x)
+			{
+				const FIntVector Voxel(x, y, z);
+
+				const bool bStartsInside = x >= StartMin.X && x <= StartMax.X && y >= StartMin.Y && y <= StartMax.Y &&
+					z >= StartMin.Z && z <= StartMax.Z;
+
+				if (bStartsInside || !IsSolid(Voxel))
+					continue;
+
+				// The box center as a ray against the voxel grown by the box
+				const FBox Target = GetVoxelBox(Voxel).ExpandBy(Extent);
+
+				double Enter = -UE_BIG_NUMBER;
+				double Exit = UE_BIG_NUMBER;
+				int EnterAxis = INDEX_NONE;
+				bool bMiss = false;
+
+				for (int Axis = 0; Axis < 3 && !bMiss; ++Axis)
+				{
+					if (FMath::IsNearlyZero(Delta[Axis]))
+					{
+						// Sliding along a face only touches it
+						bMiss = Origin[Axis] <= Target.Min[Axis] + Skin || Origin[Axis] >= Target.Max[Axis] - Skin;
+						continue;
+					}
+
+					double T0 = (Target.Min[Axis] - Origin[Axis]) / Delta[Axis];
+					double T1 = (Target.Max[Axis] - Origin[Axis]) / Delta[Axis];
+
+					if (T0 > T1)
+					{
+						Swap(T0, T1);
+					}
+
+					if (T0 > Enter)
+					{
+						Enter = T0;
+						EnterAxis = Axis;
+					}
+
+					Exit = FMath::Min(Exit, T1);
+				}
+
+				if (bMiss || EnterAxis == INDEX_NONE || Enter >= Exit || Exit <= 0.0 || Enter > 1.0)
+					continue;
+
+				// Slightly negative when it starts within Skin of the voxel
+				Enter = FMath::Max(Enter, 0.0);
+
+				if (!Hit.bBlocked || Enter < Hit.Time)
+				{
+					Hit.bBlocked = true;
+					Hit.Time = static_cast<float>(Enter);
+					Hit.Voxel = Voxel;
+					Hit.Normal = FVector::ZeroVector;
+					Hit.Normal[EnterAxis] = Delta[EnterAxis] > 0 ? -1.0 : 1.0;
+				}
+			}
+		}
+	}
+
+	return Hit;
+}
+
+FVoxelCollision::FSweepHit FVoxelCollision::SweepCapsule(const FVector& Center, float Radius, float HalfHeight,
+                                                          const FVector& Delta) const
+{
+	FSweepHit Hit;
+
+	if (Delta.IsNearlyZero() || Radius <= 0.0f)
+		return Hit;
+
+	const FVector Extent(Radius, Radius, FMath::Max(HalfHeight, Radius));
+	const FBox Bounds(Center - Extent, Center + Extent);
+
+	FIntVector Min, Max;
+	GetVoxelRange((Bounds + Bounds.ShiftBy(Delta)).ExpandBy(Skin), Min, Max);
+
+	const double Reach = FMath::Square(FMath::Max(Radius - Skin, 0.0f));
+
+	TArray<FBox, TInlineAllocator<64>> Candidates;
+	TArray<FIntVector, TInlineAllocator<64>> CandidateVoxels;
+
+	for (int z = Min.Z; z <= Max.Z; ++z)
+	{
+		for (int y = Min.Y; y <= Max.Y; ++y)
+		{
+			for (int x = Min.X; x <= Max.X; ++x)
+			{
+				const FIntVector Voxel(x, y, z);
+				if (!IsSolid(Voxel))
+					continue;
+
+				const FBox VoxelBox = GetVoxelBox(Voxel);
+				if (GetCapsuleDistanceSquared(Center, Radius, HalfHeight, VoxelBox) < Reach)
+					continue;
+
+				Candidates.Add(VoxelBox);
+				CandidateVoxels.Add(Voxel);
+			}
+		}
+	}
+
+	if (Candidates.IsEmpty())
+		return Hit;
+
+	auto FindOverlap = [&](float Time)
+	{
+		const FVector At = Center + Delta * Time;
+
+		for (int32 i = 0; i < Candidates.Num(); ++i)
+		{
+			if (GetCapsuleDistanceSquared(At, Radius, HalfHeight, Candidates[i]) < Reach)
+				return i;
+		}
+
+		return static_cast<int32>(INDEX_NONE);
+	};
+
+	// Steps of half the radius can't pass a voxel, the first overlapping step is narrowed down by bisection
+	const int32 Steps = FMath::Max(1, FMath::CeilToInt(Delta.Size() / (Radius * 0.5f)));
+
+	float Free = 0.0f;
+	int32 Blocking = INDEX_NONE;
+
+	for (int32 Step = 1; Step <= Steps && Blocking == INDEX_NONE; ++Step)
+	{
+		const float Time = static_cast<float>(Step) / Steps;
+		Blocking = FindOverlap(Time);
+
+		if (Blocking == INDEX_NONE)
+		{
+			Free = Time;
+			continue;
+		}
+
+		float Blocked = Time;
+		for (int i = 0; i < 12; ++i)
+		{
+			const float Mid = (Free + Blocked) * 0.5f;
+			const int32 MidBlocking = FindOverlap(Mid);
+
+			if (MidBlocking == INDEX_NONE)
+			{
+				Free = Mid;
+			}
+			else
+			{
+				Blocked = Mid;
+				Blocking = MidBlocking;
+			}
+		}
+	}
+
+	if (Blocking == INDEX_NONE)
+		return Hit;
+
+	Hit.bBlocked = true;
+	Hit.Time = Free;
+	Hit.Voxel = CandidateVoxels[Blocking];
+
+	// From the nearest point of the voxel to the nearest point of the capsule's segment
+	const FBox& VoxelBox = Candidates[Blocking];
+	const FVector At = Center + Delta * Free;
+	const float SegmentHalf = FMath::Max(HalfHeight - Radius, 0.0f);
+
+	const double SegmentZ = FMath::Clamp(FMath::Clamp(At.Z, VoxelBox.Min.Z, VoxelBox.Max.Z), At.Z - SegmentHalf,
+	                                    At.Z + SegmentHalf);
+	const FVector SegmentPoint(At.X, At.Y, SegmentZ);
+
+	Hit.Normal = (SegmentPoint - VoxelBox.GetClosestPointTo(SegmentPoint)).GetSafeNormal();
+	if (Hit.Normal.IsZero())
+	{
+		Hit.Normal = -Delta.GetSafeNormal();
+	}
+
+	return Hit;
+}
+
+FVector FVoxelCollision::MoveBox(FBox& InOutBox, const FVector& Delta, FIntVector& OutBlocked) const
+{
+	static constexpr int Order[] = {2, 0, 1};
+
+	FVector Moved = FVector::ZeroVector;
+	OutBlocked = FIntVector::ZeroValue;
+
+	for (const int Axis : Order)
+	{
+		if (FMath::IsNearlyZero(Delta[Axis]))
+			continue;
+
+		FVector Step = FVector::ZeroVector;
+		Step[Axis] = Delta[Axis];
+
+		const FSweepHit Hit = SweepBox(InOutBox, Step);
+		if (Hit.bBlocked)
+		{
+			Step[Axis] = FMath::Sign(Delta[Axis]) * FMath::Max(FMath::Abs(Delta[Axis]) * Hit.Time - Skin, 0.0);
+			OutBlocked[Axis] = 1;
+		}
+
+		InOutBox = InOutBox.ShiftBy(Step);
+		Moved += Step;
+	}
+
+	return Moved;
+}
+
+bool FVoxelCollision::ProbeGround(const FBox& Box, float MaxDistance, float& OutDistance) const
+{
+	const FSweepHit Hit = SweepBox(Box, FVector(0, 0, -MaxDistance));
+	if (!Hit.bBlocked)
+		return false;
+
+	OutDistance = Hit.Time * MaxDistance;
+	return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AChunkWorld;
+
+/**
+ * Collision queries straight against the voxels of an AChunkWorld, without cooked meshes or the physics scene.
+ * World space, game thread only. Capsules are upright and HalfHeight includes the hemispheres, like
+ * UCapsuleComponent. Sweeps ignore the voxels a shape starts in, so it can always move out of them.
+ */
+class FVoxelCollision
+{
+public:
+	explicit FVoxelCollision(const AChunkWorld& InWorld);
+
+	struct FSweepHit
+	{
+		bool bBlocked = false;
+
+		// Fraction of the delta travelled before touching
+		float Time = 1.0f;
+
+		FVector Normal = FVector::ZeroVector;
+		FIntVector Voxel = FIntVector::ZeroValue;
+	};
+
+	// Gap kept to the voxels by MoveBox, touching closer than this doesn't count as overlapping
+	static constexpr float Skin = 0.01f;
+
+	bool IsSolid(const FIntVector& Voxel) const;
+	FIntVector GetVoxel(const FVector& Location) const;
+
+	bool OverlapBox(const FBox& Box) const;
+	bool OverlapCapsule(const FVector& Center, float Radius, float HalfHeight) const;
+
+	FSweepHit SweepBox(const FBox& Box, const FVector& Delta) const;
+	FSweepHit SweepCapsule(const FVector& Center, float Radius, float HalfHeight, const FVector& Delta) const;
+
+	// Moves the box one axis at a time, Z first, each stopping Skin short of the first voxel. Slides along walls.
+	// Returns the delta actually moved, OutBlocked has a 1 for every axis that was cut short.
+	FVector MoveBox(FBox& InOutBox, const FVector& Delta, FIntVector& OutBlocked) const;
+
+	// Distance from the bottom of the box down to solid ground, false if there is none within MaxDistance
+	bool ProbeGround(const FBox& Box, float MaxDistance, float& OutDistance) const;
+
+private:
+	// Voxels the box overlaps by more than Skin, empty if Min > Max on an axis
+	void GetVoxelRange(const FBox& Box, FIntVector& OutMin, FIntVector& OutMax) const;
+
+	FBox GetVoxelBox(const FIntVector& Voxel) const;
+
+	static double GetCapsuleDistanceSquared(const FVector& Center, float Radius, float HalfHeight, const FBox& Box);
+
+	const AChunkWorld& World;
+	float VoxelSize;
+};
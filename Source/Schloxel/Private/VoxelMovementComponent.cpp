@@ -0,0 +1,223 @@
+#include "VoxelMovementComponent.h"
+#include "ChunkWorld.h"
+#include "VoxelCollision.h"
+#include "EngineUtils.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PhysicsVolume.h"
+
+void UVoxelMovementComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (FindChunkWorld() && bStartInVoxelMode)
+	{
+		SetMovementMode(MOVE_Custom, VoxelMovementMode);
+	}
+}
+
+bool UVoxelMovementComponent::FindChunkWorld()
+{
+	if (!ChunkWorld && GetWorld())
+	{
+		for (TActorIterator<AChunkWorld> It(GetWorld()); It; ++It)
+		{
+			ChunkWorld = *It;
+			break;
+		}
+	}
+
+	return ChunkWorld != nullptr;
+}
+
+void UVoxelMovementComponent::SetDefaultMovementMode()
+{
+	// Possession resets the mode after BeginPlay
+	if (bStartInVoxelMode && FindChunkWorld())
+	{
+		SetMovementMode(MOVE_Custom, VoxelMovementMode);
+		return;
+	}
+
+	Super::SetDefaultMovementMode();
+}
+
+bool UVoxelMovementComponent::IsMovingOnGround() const
+{
+	return IsInVoxelMode() ? bVoxelGrounded : Super::IsMovingOnGround();
+}
+
+bool UVoxelMovementComponent::IsFalling() const
+{
+	return IsInVoxelMode() ? !bVoxelGrounded : Super::IsFalling();
+}
+
+float UVoxelMovementComponent::GetMaxSpeed() const
+{
+	return IsInVoxelMode() ? MaxWalkSpeed : Super::GetMaxSpeed();
+}
+
+bool UVoxelMovementComponent::DoJump(bool bReplayingMoves, float DeltaTime)
+{
+	if (!IsInVoxelMode())
+		return Super::DoJump(bReplayingMoves, DeltaTime);
+
+	if (!CharacterOwner || !CharacterOwner->CanJump())
+		return false;
+
+	// Stays in the voxel mode instead of switching to MOVE_Falling
+	Velocity.Z = FMath::Max<FVector::FReal>(Velocity.Z, JumpZVelocity);
+	bVoxelGrounded = false;
+	return true;
+}
+
+void UVoxelMovementComponent::PhysCustom(float DeltaTime, int32 Iterations)
+{
+	if (CustomMovementMode != VoxelMovementMode)
+	{
+		Super::PhysCustom(DeltaTime, Iterations);
+		return;
+	}
+
+	PhysVoxel(DeltaTime);
+}
+
+FBox UVoxelMovementComponent::GetVoxelBounds(const FVector& Location) const
+{
+	float Radius = 0.0f;
+	float HalfHeight = 0.0f;
+	CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleSize(Radius, HalfHeight);
+
+	const FVector Extent(Radius, Radius, HalfHeight);
+	return FBox(Location - Extent, Location + Extent);
+}
+
+void UVoxelMovementComponent::PhysVoxel(float DeltaTime)
+{
+	if (DeltaTime < MIN_TICK_TIME || !ChunkWorld || !CharacterOwner)
+		return;
+
+	const FVoxelCollision Collision(*ChunkWorld);
+
+	// Only set when the floor under the capsule isn't made of voxels
+	CurrentFloor.Clear();
+
+	// Horizontal speed like walking on the ground and falling in the air, vertical speed from gravity alone
+	const FVector::FReal VerticalSpeed = Velocity.Z;
+	Velocity.Z = 0.0;
+
+	if (bVoxelGrounded)
+	{
+		Acceleration.Z = 0.0;
+		CalcVelocity(DeltaTime, GroundFriction, false, BrakingDecelerationWalking);
+		Velocity.Z = 0.0;
+	}
+	else
+	{
+		Acceleration = GetFallingLateralAcceleration(DeltaTime);
+		Acceleration.Z = 0.0;
+		CalcVelocity(DeltaTime, FallingLateralFriction, false, BrakingDecelerationFalling);
+		Velocity.Z = FMath::Max<FVector::FReal>(VerticalSpeed + GetGravityZ() * DeltaTime,
+		                                        -GetPhysicsVolume()->TerminalVelocity);
+	}
+
+	const FVector Start = UpdatedComponent->GetComponentLocation();
+	const FVector Delta = Velocity * DeltaTime;
+
+	FBox Box = GetVoxelBounds(Start);
+	FIntVector Blocked;
+	FVector Moved = Collision.MoveBox(Box, Delta, Blocked);
+
+	// Ledges up to MaxStepHeight are climbed by trying the same move from higher up
+	if (bVoxelGrounded && (Blocked.X || Blocked.Y) && MaxStepHeight > 0.0f)
+	{
+		FBox Raised = GetVoxelBounds(Start);
+		FIntVector Ignored;
+		FIntVector RaisedBlocked;
+
+		const FVector Lift = Collision.MoveBox(Raised, FVector(0, 0, MaxStepHeight), Ignored);
+		const FVector Across = Collision.MoveBox(Raised, FVector(Delta.X, Delta.Y, 0), RaisedBlocked);
+		const FVector Drop = Collision.MoveBox(Raised, FVector(0, 0, -Lift.Z), Ignored);
+
+		if (Across.SizeSquared2D() > Moved.SizeSquared2D() + UE_KINDA_SMALL_NUMBER)
+		{
+			Box = Raised;
+			Moved = Lift + Across + Drop;
+			Blocked = RaisedBlocked;
+		}
+	}
+
+	for (int Axis = 0; Axis < 3; ++Axis)
+	{
+		if (Blocked[Axis])
+		{
+			Velocity[Axis] = 0.0;
+		}
+	}
+
+	const bool bWasGrounded = bVoxelGrounded;
+
+	float GroundDistance = 0.0f;
+	bVoxelGrounded = Velocity.Z <= 0.0 && Collision.ProbeGround(Box, GroundProbeDistance, GroundDistance);
+
+	if (bVoxelGrounded)
+	{
+		// Kept on the ground when walking down, instead of hopping off every small drop
+		FIntVector Ignored;
+		Moved += Collision.MoveBox(Box, FVector(0, 0, -GroundDistance), Ignored);
+		Velocity.Z = 0.0;
+	}
+
+	// Props, pawns and anything else that isn't a voxel are swept against like in the stock modes. The voxels
+	// themselves are already Skin away from the box, their cooked collision doesn't stop the capsule again.
+	FHitResult Hit(1.0f);
+	if (!Moved.IsNearlyZero())
+	{
+		SafeMoveUpdatedComponent(Moved, UpdatedComponent->GetComponentQuat(), true, Hit);
+
+		if (Hit.IsValidBlockingHit())
+		{
+			HandleImpact(Hit, DeltaTime, Moved);
+			SlideAlongSurface(Moved, 1.0f - Hit.Time, Hit.Normal, Hit, true);
+
+			if ((Velocity | Hit.Normal) < 0.0)
+			{
+				Velocity = FVector::VectorPlaneProject(Velocity, Hit.Normal);
+			}
+		}
+	}
+
+	// Standing on something other than voxels
+	if (!bVoxelGrounded && Velocity.Z <= 0.0)
+	{
+		FindFloor(UpdatedComponent->GetComponentLocation(), CurrentFloor, false);
+
+		if (CurrentFloor.IsWalkableFloor())
+		{
+			bVoxelGrounded = true;
+			Velocity.Z = 0.0;
+		}
+	}
+
+	if (bVoxelGrounded && !bWasGrounded)
+	{
+		if (!CurrentFloor.IsWalkableFloor() || !CurrentFloor.HitResult.IsValidBlockingHit())
+		{
+			Hit = FHitResult(1.0f);
+			Hit.bBlockingHit = true;
+			Hit.Location = UpdatedComponent->GetComponentLocation();
+			Hit.ImpactPoint = FVector(Hit.Location.X, Hit.Location.Y, GetVoxelBounds(Hit.Location).Min.Z);
+			Hit.Normal = Hit.ImpactNormal = FVector::UpVector;
+		}
+		else
+		{
+			Hit = CurrentFloor.HitResult;
+		}
+
+		// Same notification as landing from MOVE_Falling. The mode doesn't change, so the jump count that
+		// ACharacter resets on mode changes is reset here.
+		CharacterOwner->Landed(Hit);
+		CharacterOwner->JumpCurrentCount = 0;
+		CharacterOwner->JumpCurrentCountPreJump = 0;
+	}
+}
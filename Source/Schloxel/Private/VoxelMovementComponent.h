@@ -0,0 +1,58 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "VoxelMovementComponent.generated.h"
+
+class AChunkWorld;
+
+/**
+ * Walks and falls through a custom movement mode that collides with the voxels of a chunk world directly, see
+ * FVoxelCollision. The capsule moves as its bounding box, one axis at a time, and steps up ledges of up to
+ * MaxStepHeight. The move is then swept through the physics scene, so props and other actors still block it and
+ * can be stood on, only without the step ups of the stock walking mode. Other movement modes behave like the
+ * stock component.
+ */
+UCLASS(ClassGroup=(Movement), meta=(BlueprintSpawnableComponent))
+class UVoxelMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	// CustomMovementMode of MOVE_Custom that runs PhysVoxel
+	static constexpr uint8 VoxelMovementMode = 0;
+
+	// Found in the level on BeginPlay if unset
+	UPROPERTY(EditAnywhere, Category="Character Movement: Voxel")
+	TObjectPtr<AChunkWorld> ChunkWorld;
+
+	// Switches to the voxel mode on BeginPlay, otherwise call SetMovementMode(MOVE_Custom, VoxelMovementMode)
+	UPROPERTY(EditAnywhere, Category="Character Movement: Voxel")
+	bool bStartInVoxelMode = true;
+
+	// Still standing if the ground is at most this far below
+	UPROPERTY(EditAnywhere, Category="Character Movement: Voxel", meta=(ClampMin=0, Units="cm"))
+	float GroundProbeDistance = 2.0f;
+
+	bool IsInVoxelMode() const { return MovementMode == MOVE_Custom && CustomMovementMode == VoxelMovementMode; }
+
+	virtual bool IsMovingOnGround() const override;
+	virtual bool IsFalling() const override;
+	virtual bool DoJump(bool bReplayingMoves, float DeltaTime) override;
+	virtual float GetMaxSpeed() const override;
+	virtual void SetDefaultMovementMode() override;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void PhysCustom(float DeltaTime, int32 Iterations) override;
+
+private:
+	void PhysVoxel(float DeltaTime);
+
+	bool FindChunkWorld();
+
+	// Bounds of the capsule around a component location
+	FBox GetVoxelBounds(const FVector& Location) const;
+
+	bool bVoxelGrounded = false;
+};
@@ -18,5 +18,6 @@ enum class EBlock : uint8
 	Air,
 	Stone,
 	Dirt,
-	Grass
+	Grass,
+	Lamp
 };
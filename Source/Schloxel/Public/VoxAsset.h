@@ -0,0 +1,103 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Serialization/BulkData.h"
+#include "VoxImporter.h"
+#include "VoxAsset.generated.h"
+
+class UAssetImportData;
+
+// Location of one brick inside the compressed payload
+struct FVoxBrickEntry
+{
+	uint32 Offset = 0;
+
+	// 0 means the brick is uniform and has no payload
+	uint32 CompressedSize = 0;
+
+	uint8 UniformValue = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FVoxBrickEntry& Entry)
+	{
+		Ar << Entry.Offset;
+		Ar << Entry.CompressedSize;
+		Ar << Entry.UniformValue;
+		return Ar;
+	}
+};
+
+// One model grid inside the brick table
+struct FVoxAssetGrid
+{
+	FIntVector Dimensions = FIntVector::ZeroValue;
+	int32 FirstBrick = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FVoxAssetGrid& Grid)
+	{
+		Ar << Grid.Dimensions;
+		Ar << Grid.FirstBrick;
+		return Ar;
+	}
+};
+
+// Everything an import produces, built off the game thread and swapped into the asset afterwards
+struct FVoxAssetPayload
+{
+	FIntVector ModelDimensions = FIntVector::ZeroValue;
+	FIntVector SceneOrigin = FIntVector::ZeroValue;
+	TArray<FColor> Palette;
+	FVoxSceneGraph SceneGraph;
+	TArray<FVoxAssetGrid> Grids;
+	TArray<FVoxBrickEntry> BrickTable;
+	TArray<uint8> CompressedBricks;
+};
+
+/**
+ * A MagicaVoxel scene cooked into bricks of palette indices. Every unique model is stored once,
+ * the scene graph places them. The bricks live in bulk data so they are streamed on demand
+ * instead of being loaded with the asset.
+ */
+UCLASS(BlueprintType)
+class SCHLOXEL_API UVoxAsset : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Size of the flattened scene
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FIntVector ModelDimensions = FIntVector::ZeroValue;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FIntVector SceneOrigin = FIntVector::ZeroValue;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	TArray<FColor> Palette;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FVoxSceneGraph SceneGraph;
+
+#if WITH_EDITORONLY_DATA
+	UPROPERTY(VisibleAnywhere, Instanced, Category="Import Settings")
+	TObjectPtr<UAssetImportData> AssetImportData;
+#endif
+
+	virtual void PostInitProperties() override;
+	virtual void Serialize(FArchive& Ar) override;
+
+	// Thread safe, bricks and compresses the models of an import result
+	static bool BuildPayload(const FVoxImportResult& Result, FVoxAssetPayload& OutPayload);
+
+	// Game thread only
+	void ApplyPayload(FVoxAssetPayload&& Payload);
+
+	// Streams the bricks in and decodes them on the thread pool. Must be called on the game thread.
+	TFuture<FVoxImportResult> LoadVoxelDataAsync(const TSharedRef<FVoxImportState>& State, bool bFlatten = true) const;
+
+private:
+	TArray<FVoxAssetGrid> Grids;
+
+	TArray<FVoxBrickEntry> BrickTable;
+
+	FByteBulkData BrickBulkData;
+};
@@ -0,0 +1,161 @@
+﻿#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Enums.h"
+#include "VoxImporter.generated.h"
+
+// Shared between the game thread and an async import task
+struct FVoxImportState
+{
+	// 0..1, written by the import task. Left where it stopped if the task fails.
+	std::atomic<float> Progress{0.0f};
+
+	// Set by the owner to abort the import at the next checkpoint
+	std::atomic<bool> bCancelRequested{false};
+
+	// Set by the task when it gave up or was cancelled
+	std::atomic<bool> bFailed{false};
+
+	void Cancel() { bCancelRequested = true; }
+	bool IsCancelled() const { return bCancelRequested; }
+
+	// Called by the task once it is done either way
+	void Finish(bool bSucceeded)
+	{
+		if (bSucceeded)
+		{
+			Progress = 1.0f;
+		}
+		else
+		{
+			bFailed = true;
+		}
+	}
+
+	bool HasFailed() const { return bFailed; }
+};
+
+USTRUCT()
+struct FVoxSceneModel
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FIntVector Size = FIntVector::ZeroValue;
+};
+
+USTRUCT()
+struct FVoxSceneInstance
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FString Name;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	int32 ModelIndex = INDEX_NONE;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	int32 GroupIndex = INDEX_NONE;
+
+	// MagicaVoxel transforms may mirror, so they are kept as a matrix
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FMatrix Transform = FMatrix::Identity;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	bool bHidden = false;
+};
+
+USTRUCT()
+struct FVoxSceneGroup
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FString Name;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	int32 ParentIndex = INDEX_NONE;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	FMatrix Transform = FMatrix::Identity;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	bool bHidden = false;
+};
+
+USTRUCT()
+struct FVoxSceneGraph
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	TArray<FVoxSceneModel> Models;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	TArray<FVoxSceneInstance> Instances;
+
+	UPROPERTY(VisibleAnywhere, Category="Vox")
+	TArray<FVoxSceneGroup> Groups;
+};
+
+// One unique model of the scene, shared by all instances that reference it
+struct FVoxModelGrid
+{
+	FIntVector Dimensions = FIntVector::ZeroValue;
+
+	// Palette indices in x -> y -> z order, 0 is empty
+	TArray<uint8> ColorIndices;
+};
+
+struct FVoxImportResult
+{
+	bool bSuccess = false;
+
+	// All instances rasterized into one grid, empty unless flattening was requested
+	TArray<EBlock> VoxelData;
+	FIntVector ModelDimensions = FIntVector::ZeroValue;
+
+	// Min corner of the flattened scene in vox space
+	FIntVector SceneOrigin = FIntVector::ZeroValue;
+
+	TArray<FVoxModelGrid> Models;
+	TArray<FColor> Palette;
+	FVoxSceneGraph SceneGraph;
+};
+
+UCLASS()
+class SCHLOXEL_API UVoxImporter : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	bool LoadVoxFile(const FString& FilePath);
+	TArray<EBlock> GetVoxelData() const;
+	TArray<EBlock> TakeVoxelData();
+	FIntVector GetModelSize() const;
+
+	// Reads and rasterizes the file on the thread pool. Cancel through State.
+	static TFuture<FVoxImportResult> LoadVoxFileAsync(const FString& FilePath,
+	                                                  const TSharedRef<FVoxImportState>& State,
+	                                                  bool bFlatten = true);
+
+	// Thread safe. Without bFlatten only the unique models and the scene graph are read.
+	static bool ImportVoxFile(const FString& FilePath, FVoxImportResult& OutResult, FVoxImportState* State,
+	                          bool bFlatten = true);
+
+	// Thread safe. Rasterizes every instance of Result.Models into Result.VoxelData.
+	static bool FlattenScene(FVoxImportResult& Result, FVoxImportState* State, float ProgressStart = 0.0f);
+	
+	TArray<TArray<EBlock>> VoxelDataArray;
+	TArray<FIntVector> ModelDimensionsArray;
+
+	
+private:
+
+	TArray<EBlock> VoxelData;
+	FIntVector ModelDimensions;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Voxel grids are stored and streamed in cubic bricks
+namespace VoxelBrick
+{
+	constexpr int32 Size = 16;
+	constexpr int32 NumVoxels = Size * Size * Size;
+
+	inline FIntVector GetBrickCount(const FIntVector& Dimensions)
+	{
+		return FIntVector(
+			FMath::DivideAndRoundUp(Dimensions.X, Size),
+			FMath::DivideAndRoundUp(Dimensions.Y, Size),
+			FMath::DivideAndRoundUp(Dimensions.Z, Size)
+		);
+	}
+
+	inline int32 GetBrickIndex(const FIntVector& Brick, const FIntVector& BrickCount)
+	{
+		return Brick.X + Brick.Y * BrickCount.X + Brick.Z * BrickCount.X * BrickCount.Y;
+	}
+
+	inline FIntVector GetBrickCoord(int32 BrickIndex, const FIntVector& BrickCount)
+	{
+		return FIntVector(
+			BrickIndex % BrickCount.X,
+			(BrickIndex / BrickCount.X) % BrickCount.Y,
+			BrickIndex / (BrickCount.X * BrickCount.Y)
+		);
+	}
+
+	// Linear x -> y -> z order inside a brick, also the order bricks are stored on disk
+	inline int32 GetLocalIndex(int32 X, int32 Y, int32 Z)
+	{
+		return X + Y * Size + Z * Size * Size;
+	}
+
+	static_assert(Size == 16, "Morton indices interleave four bits per axis");
+
+	// Moves the four bits of a local coordinate three places apart
+	constexpr uint32 SpreadBits(uint32 Value)
+	{
+		return (Value & 1) | (Value & 2) << 2 | (Value & 4) << 4 | (Value & 8) << 6;
+	}
+
+	// Bits of each axis in a Morton index
+	constexpr uint32 MortonAxisMask[3] = {0x249, 0x492, 0x924};
+
+	// Z-order inside a brick, neighbours along every axis stay close in memory
+	inline int32 GetMortonIndex(int32 X, int32 Y, int32 Z)
+	{
+		return static_cast<int32>(SpreadBits(X) | SpreadBits(Y) << 1 | SpreadBits(Z) << 2);
+	}
+
+	// Morton index of the neighbour one step along the axis, the neighbour has to be inside the same brick
+	inline int32 StepMortonIndex(int32 Index, int32 Axis, int32 Step)
+	{
+		const uint32 Mask = MortonAxisMask[Axis];
+		const uint32 Bits = Step > 0 ? ((Index | ~Mask) + 1) & Mask : ((Index & Mask) - 1) & Mask;
+		return static_cast<int32>((Index & ~Mask) | Bits);
+	}
+}
@@ -10,6 +10,6 @@ public class SchloxelEditorTarget : TargetRules
 		Type = TargetType.Editor;
 		DefaultBuildSettings = BuildSettingsVersion.V4;
 
-		ExtraModuleNames.AddRange( new string[] { "Schloxel" } );
+		ExtraModuleNames.AddRange( new string[] { "Schloxel", "SchloxelEditor" } );
 	}
 }
@@ -0,0 +1,168 @@
+#include "VoxAssetFactory.h"
+
+#include "VoxAsset.h"
+#include "VoxImporter.h"
+#include "Async/ParallelFor.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "EditorFramework/AssetImportData.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopedSlowTask.h"
+
+#define LOCTEXT_NAMESPACE "VoxAssetFactory"
+
+static FAutoConsoleCommand ReimportVoxFolderCommand(
+	TEXT("Vox.ReimportFolder"),
+	TEXT("Reimports every vox asset below a content folder in parallel, e.g. Vox.ReimportFolder /Game/Vox"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Count = UVoxAssetFactory::ReimportFolder(Args.Num() > 0 ? Args[0] : TEXT("/Game"));
+		UE_LOG(LogTemp, Log, TEXT("Reimported %d vox assets"), Count);
+	}));
+
+UVoxAssetFactory::UVoxAssetFactory()
+{
+	SupportedClass = UVoxAsset::StaticClass();
+	bCreateNew = false;
+	bEditorImport = true;
+	bText = false;
+
+	Formats.Add(TEXT("vox;MagicaVoxel Model"));
+}
+
+UObject* UVoxAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags,
+                                             const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn,
+                                             bool& bOutOperationCanceled)
+{
+	FVoxImportResult Result;
+	FVoxAssetPayload Payload;
+
+	if (!UVoxImporter::ImportVoxFile(Filename, Result, nullptr, false) || !UVoxAsset::BuildPayload(Result, Payload))
+	{
+		Warn->Logf(ELogVerbosity::Error, TEXT("Failed to import %s"), *Filename);
+		return nullptr;
+	}
+
+	UVoxAsset* Asset = NewObject<UVoxAsset>(InParent, InClass, InName, Flags);
+	Asset->ApplyPayload(MoveTemp(Payload));
+	Asset->AssetImportData->Update(Filename);
+
+	return Asset;
+}
+
+bool UVoxAssetFactory::CanReimport(UObject* Obj, TArray<FString>& OutFilenames)
+{
+	const UVoxAsset* Asset = Cast<UVoxAsset>(Obj);
+	if (!Asset || !Asset->AssetImportData)
+		return false;
+
+	Asset->AssetImportData->ExtractFilenames(OutFilenames);
+	return true;
+}
+
+void UVoxAssetFactory::SetReimportPaths(UObject* Obj, const TArray<FString>& NewReimportPaths)
+{
+	const UVoxAsset* Asset = Cast<UVoxAsset>(Obj);
+	if (Asset && Asset->AssetImportData && NewReimportPaths.Num() == 1)
+	{
+		Asset->AssetImportData->UpdateFilenameOnly(NewReimportPaths[0]);
+	}
+}
+
+EReimportResult::Type UVoxAssetFactory::Reimport(UObject* Obj)
+{
+	UVoxAsset* Asset = Cast<UVoxAsset>(Obj);
+	if (!Asset)
+		return EReimportResult::Failed;
+
+	return ReimportAssets({Asset}) == 1 ? EReimportResult::Succeeded : EReimportResult::Failed;
+}
+
+int32 UVoxAssetFactory::GetPriority() const
+{
+	return ImportPriority;
+}
+
+int32 UVoxAssetFactory::ReimportAssets(const TArray<UVoxAsset*>& Assets)
+{
+	FScopedSlowTask SlowTask(Assets.Num(), LOCTEXT("ReimportingVox", "Reimporting vox assets..."));
+	SlowTask.MakeDialog();
+
+	TArray<FString> Filenames;
+	Filenames.SetNum(Assets.Num());
+
+	for (int32 i = 0; i < Assets.Num(); i++)
+	{
+		if (Assets[i] && Assets[i]->AssetImportData)
+		{
+			Filenames[i] = Assets[i]->AssetImportData->GetFirstFilename();
+		}
+	}
+
+	TArray<FVoxAssetPayload> Payloads;
+	Payloads.SetNum(Assets.Num());
+
+	TArray<bool> Succeeded;
+	Succeeded.SetNumZeroed(Assets.Num());
+
+	// Parsing and brick compression are independent per file
+	ParallelFor(Assets.Num(), [&](int32 i)
+	{
+		if (Filenames[i].IsEmpty())
+			return;
+
+		FVoxImportResult Result;
+		Succeeded[i] = UVoxImporter::ImportVoxFile(Filenames[i], Result, nullptr, false) &&
+			UVoxAsset::BuildPayload(Result, Payloads[i]);
+	});
+
+	int32 NumReimported = 0;
+
+	for (int32 i = 0; i < Assets.Num(); i++)
+	{
+		SlowTask.EnterProgressFrame();
+
+		if (!Succeeded[i])
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Failed to reimport %s from '%s'"),
+			       Assets[i] ? *Assets[i]->GetPathName() : TEXT("null"), *Filenames[i]);
+			continue;
+		}
+
+		UVoxAsset* Asset = Assets[i];
+		Asset->Modify();
+		Asset->ApplyPayload(MoveTemp(Payloads[i]));
+		Asset->AssetImportData->Update(Filenames[i]);
+		Asset->PostEditChange();
+		Asset->MarkPackageDirty();
+
+		NumReimported++;
+	}
+
+	return NumReimported;
+}
+
+int32 UVoxAssetFactory::ReimportFolder(const FString& PackagePath)
+{
+	const IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+
+	FARFilter Filter;
+	Filter.PackagePaths.Add(FName(*PackagePath));
+	Filter.bRecursivePaths = true;
+	Filter.ClassPaths.Add(UVoxAsset::StaticClass()->GetClassPathName());
+
+	TArray<FAssetData> AssetDataList;
+	AssetRegistry.GetAssets(Filter, AssetDataList);
+
+	TArray<UVoxAsset*> Assets;
+	for (const FAssetData& AssetData : AssetDataList)
+	{
+		if (UVoxAsset* Asset = Cast<UVoxAsset>(AssetData.GetAsset()))
+		{
+			Assets.Add(Asset);
+		}
+	}
+
+	return ReimportAssets(Assets);
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EditorReimportHandler.h"
+#include "Factories/Factory.h"
+#include "VoxAssetFactory.generated.h"
+
+class UVoxAsset;
+
+UCLASS()
+class UVoxAssetFactory : public UFactory, public FReimportHandler
+{
+	GENERATED_BODY()
+
+public:
+	UVoxAssetFactory();
+
+	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags,
+	                                   const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn,
+	                                   bool& bOutOperationCanceled) override;
+
+	virtual bool CanReimport(UObject* Obj, TArray<FString>& OutFilenames) override;
+	virtual void SetReimportPaths(UObject* Obj, const TArray<FString>& NewReimportPaths) override;
+	virtual EReimportResult::Type Reimport(UObject* Obj) override;
+	virtual int32 GetPriority() const override;
+
+	// Parses and compresses every source file in parallel, then swaps the results in on the game thread
+	static int32 ReimportAssets(const TArray<UVoxAsset*>& Assets);
+
+	// Reimports every UVoxAsset below a content folder, e.g. /Game/Vox
+	static int32 ReimportFolder(const FString& PackagePath);
+};
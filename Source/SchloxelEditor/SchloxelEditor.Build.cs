@@ -0,0 +1,19 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class SchloxelEditor : ModuleRules
+{
+	public SchloxelEditor(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(new string[]
+			{ "Core", "CoreUObject", "Engine" });
+
+		PrivateDependencyModuleNames.AddRange(new string[]
+			{ "UnrealEd", "AssetRegistry", "Schloxel" });
+
+		CppStandard = CppStandardVersion.Cpp20;
+	}
+}